@@ -1,20 +1,27 @@
 #pragma once
 
 #include <stdarg.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
 #include "IdlParser.h"
+#include "IdlLayout.h"
+#include "IdlOutput.h"
+#include "IdlProfile.h"
 
 class GenException : public std::exception
 {
 protected:
-	PTElement *m_pNode;
+	AstIdx m_iNode;
 
 public:
-	GenException( PTElement *pNode, const char* pcText )
-		: std::exception( pcText ), m_pNode(pNode)
+	GenException( AstIdx iNode, const char* pcText )
+		: std::exception( pcText ), m_iNode(iNode)
 	{
 	}
 
-	PTElement *node() const { return m_pNode; }
+	AstIdx node() const { return m_iNode; }
 };
 
 
@@ -27,121 +34,181 @@ enum eStages {
 };
 typedef unsigned int eStage;
 
+// How much of a message's wire size the generator can know. A bounded
+//  message has a constant size that only the C++ compiler can work out,
+//  from sizeof() of an enum or typedef or an array length given by name;
+//  schemas have no length limits for strings and lists, so any message
+//  holding one is unbounded.
+enum eWireClass {
+	eWire_Fixed = 0,
+	eWire_Bounded,
+	eWire_Unbounded
+};
+
+// A list goes on the wire as a uint32 element count, then its elements
+static const unsigned int LIST_COUNT_SIZE = 4;
+
+// One top-level message in a parallel generate(). Its text is written by
+//  worker iWorker at [iOffset,iOffset+iLength) of that worker's output.
+struct SGenMessage
+{
+	AstIdx iNode;
+	int iIndent;
+	unsigned short unType;
+	unsigned int iWorker;
+	size_t iOffset;
+	size_t iLength;
+	std::exception_ptr pError;
+};
+
+// One extra file of split output: a namespace's declaration header or the
+//  source holding the serializer bodies declared in it.
+struct SGenFile
+{
+	std::string sSuffix;
+	IdlOutput *pText;
+	std::vector<AstIdx> viOpen;		// source only; namespaces currently open
+};
+
 class CppGenerator
 {
 protected:
-	PTContainer *m_pRoot;
-	int m_iTabs;
-	FILE *m_fHandle;
+	const IdlAst *m_pAst;
+	const IdlLayouts *m_pLayouts;
+	IdlOutput m_xOut;
+	IdlOutput *m_pOut;				// where _outTxt writes; m_xOut unless splitting
+	IdlProfile *m_pProfile;
 	unsigned short m_unCommand;
 	unsigned short m_unMaxCommand;
+	unsigned int m_iThreads;
+	SymId m_iStringSym;
+	bool m_bUnchecked;				// set while serializing a message whose size was checked up front
+
+	// Set while a parallel generate() splices finished messages into m_xOut
+	const std::vector<SGenMessage> *m_pSplice;
+	const std::vector<CppGenerator*> *m_pWorkers;
+	size_t m_iSpliceNext;
+
+	// Split output; m_vFiles holds header/source pairs, and m_iSplitFile
+	//  is the pair the namespace being generated belongs to
+	std::string m_sSplitBase;
+	std::string m_sSplitInclude;
+	bool m_bSplit;
+	bool m_bViews;
+	std::vector<SGenFile> m_vFiles;
+	size_t m_iSplitFile;
+
+	// Messages and namespaces named by set_roots(); when there are any,
+	//  m_vbReached marks the nodes that are generated
+	std::vector<std::string> m_vRoots;
+	std::vector<bool> m_vbReached;
 
 public:
-	CppGenerator( PTContainer *pRoot )
-		: m_pRoot(pRoot), m_iTabs(0), m_fHandle(0)
+	CppGenerator( const IdlAst *pAst, const IdlLayouts *pLayouts )
+		: m_pAst(pAst), m_pLayouts(pLayouts), m_pOut(&m_xOut), m_pProfile(nullptr), m_iThreads(1), m_bUnchecked(false),
+		m_pSplice(nullptr), m_pWorkers(nullptr), m_iSpliceNext(0), m_bSplit(false), m_bViews(false), m_iSplitFile(0)
 	{
-		m_fHandle = fopen( "D:\\testOutput.txt", "wb" );
 		m_unCommand = 0x0100;
 		m_unMaxCommand = 0x03FF;
+		m_iStringSym = pAst->symbols()->find( "string" );
 	}
 
 	~CppGenerator( )
 	{
-		fclose( m_fHandle );
+		_clearFiles( );
 	}
-	
+
 	void _outTabs( int iTabs ) {
-		m_iTabs += iTabs;
+		m_pOut->indent( iTabs );
 	}
 	
 	void _outTxtX( char *format, ... )
 	{
 		va_list args;
 		va_start( args, format );
-		vfprintf( m_fHandle, format, args );
+		m_pOut->vtext( format, args );
 		va_end( args );
 	}
 
 	void _outTxt( char *format, ... )
 	{
-		for( int i = 0; i < m_iTabs; ++i ) fprintf( m_fHandle, "\t" );
 		va_list args;
 		va_start( args, format );
-		vfprintf( m_fHandle, format, args );
+		m_pOut->vline( format, args );
 		va_end( args );
 	}
 
-	std::string _getVarName( PTVar *pVar ) {
-		return "__" + pVar->get_name();
+	std::string _getVarName( AstIdx iVar ) {
+		return std::string("__") + m_pAst->name(iVar);
 	}
 
-	std::string _getListName( PTList *pList ) {
-		return "_v" + pList->get_name( );
+	std::string _getListName( AstIdx iList ) {
+		return std::string("_v") + m_pAst->name(iList);
 	}
 
-	std::string _getSerializer( PTContainer *pNode )
+	std::string _getSerializer( AstIdx iNode )
 	{
-		PTContainer *pParent = pNode->get_parent( );
-		while( pParent ) {
-			if( pParent->type() == ePT_Message ) {
-				PTMessage *pMsg = (PTMessage*)pParent;
-				return "pak_" + pMsg->get_name();
+		AstIdx iParent = m_pAst->parent( iNode );
+		while( iParent != AST_NONE ) {
+			if( m_pAst->type(iParent) == ePT_Message ) {
+				return std::string("pak_") + m_pAst->name(iParent);
 			}
-			pParent = pParent->get_parent( );
+			iParent = m_pAst->parent( iParent );
 		}
 
 		return "";
 	}
 
-	std::string _getListPath( PTList *pNode )
+	std::string _getListPath( AstIdx iNode )
 	{
-		std::string sPath = pNode->get_name( );
+		std::string sPath = m_pAst->name( iNode );
 
-		PTElement *pParent = pNode->get_parent( );
-		while( pParent && pParent->type() == ePT_List ) {
-			PTList *pList = (PTList*)pParent;
-			sPath = pList->get_name() + "::" + sPath;
-			pParent = pParent->get_parent();
+		AstIdx iParent = m_pAst->parent( iNode );
+		while( iParent != AST_NONE && m_pAst->type(iParent) == ePT_List ) {
+			sPath = m_pAst->name(iParent) + ("::" + sPath);
+			iParent = m_pAst->parent( iParent );
 		}
 
 		return sPath;
 	}
 
-	void _genContainer( PTContainer *pNode, eStage iStage )
+	void _genContainer( AstIdx iNode, eStage iStage )
 	{
-		for( auto i = pNode->get_children().begin(); i != pNode->get_children().end(); ++i ) {
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
 			_gen( *i, iStage );
 		}
 	}
 
-	void _genRoot( PTRoot *pNode, eStage iStage )
+	void _genRoot( AstIdx iNode, eStage iStage )
 	{
 		if( iStage != eStage_MAIN ) {
-			throw GenException( pNode, "namespace during incorrect stage" );
+			throw GenException( iNode, "namespace during incorrect stage" );
 		}
 
 		_outTxt( "namespace net {\n" );
 		_outTabs( +1 );
 		{
-			_genContainer( pNode, iStage );
+			_genContainer( iNode, iStage );
 		}
 		_outTabs( -1 );
 		_outTxt( "};\n" );
 	}
 
-	void _genEnum( PTEnum *pNode, eStage iStage )
+	void _genEnum( AstIdx iNode, eStage iStage )
 	{
 		if( iStage != eStage_MAIN ) {
-			throw GenException( pNode, "enum during incorrect stage" );
+			throw GenException( iNode, "enum during incorrect stage" );
 		}
 
-		_outTxt( "enum %s {\n", pNode->get_name().c_str() );
+		_outTxt( "enum %s {\n", m_pAst->name(iNode) );
 		_outTabs( +1 );
-		for( auto i = pNode->get_values().begin(); i != pNode->get_values().end(); ) {
-			_outTxt( "%s", (*i).c_str() );
+		auto xValues = m_pAst->refs( iNode );
+		for( auto i = xValues.begin(); i != xValues.end(); ) {
+			_outTxt( "%s", m_pAst->str(*i) );
 
 			++i;
-			if( i != pNode->get_values().end() ) {
+			if( i != xValues.end() ) {
 				_outTxtX( ",\n" );
 			} else {
 				_outTxtX( "\n" );
@@ -151,140 +218,606 @@ public:
 		_outTxt( "};\n" );
 	}
 
-	void _genNamespace( PTNamespace *pNode, eStage iStage )
+	void _genNamespace( AstIdx iNode, eStage iStage )
 	{
 		if( iStage != eStage_MAIN ) {
-			throw GenException( pNode, "namespace during incorrect stage" );
+			throw GenException( iNode, "namespace during incorrect stage" );
 		}
 
-		_outTxt( "namespace %s {\n", pNode->get_name().c_str() );
+		if( !_reached(iNode) ) {
+			_skipMessages( iNode );
+			return;
+		}
+
+		if( m_bSplit && m_pAst->parent(iNode) == AST_ROOT ) {
+			_genSplitNamespace( iNode );
+			return;
+		}
+
+		_outTxt( "namespace %s {\n", m_pAst->name(iNode) );
 		_outTabs( +1 );
 
-		_genContainer( pNode, iStage );
+		_genContainer( iNode, iStage );
 
 		_outTabs( -1 );
 		_outTxt( "};\n" );
 	}
 
-	void _genTypedef( PTTypedef *pNode, eStage iStage )
+	void _genTypedef( AstIdx iNode, eStage iStage )
 	{
 		if( iStage != eStage_MAIN ) {
-			throw GenException( pNode, "typedef during incorrect stage" );
+			throw GenException( iNode, "typedef during incorrect stage" );
 		}
 
-		_outTxt( "typedef %s %s;\n", pNode->get_type().c_str(), pNode->get_name().c_str() );
+		_outTxt( "typedef %s %s;\n", m_pAst->var_type(iNode), m_pAst->name(iNode) );
 	}
 
-	PTXMsgNBase* _findBaseNode( const std::string& sName, PTContainer *pStart = nullptr )
+	// Emits one stage for the layout entries [iBegin,iEnd), which sit at a
+	//  single list depth.
+	void _genFields( const SLayout& xLayout, size_t iBegin, size_t iEnd, eStage iStage )
 	{
-		if( pStart == nullptr ) pStart = m_pRoot;
+		bool bBlocks = ( iStage == eStage_SER || iStage == eStage_UNSER ) && _isPlain( xLayout, iBegin, iEnd );
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( bBlocks ) {
+				size_t iBlockEnd = _blockEnd( xLayout, i, iEnd );
+				if( iBlockEnd - i > 1 ) {
+					_genBlock( xLayout, i, iBlockEnd, iStage );
+					i = iBlockEnd - 1;
+					continue;
+				}
+			}
 
-		for( auto i = pStart->get_children().begin(); i != pStart->get_children().end(); ++i ) {
-			if( (*i)->type() != ePT_Base ) {
-				continue;
+			if( xField.iKind == eLK_List ) {
+				_genList( xLayout, i, iStage );
+				i = xField.iListEnd;
+			} else if( xField.iKind == eLK_Var ) {
+				_genVar( xField, iStage );
 			}
-			if( (*i)->name() == sName ) {
-				return (PTXMsgNBase*)(*i);
+		}
+	}
+
+	// True when [iBegin,iEnd) holds no strings or lists, so the class the
+	//  fields are members of is standard-layout and offsetof() is valid
+	bool _isPlain( const SLayout& xLayout, size_t iBegin, size_t iEnd )
+	{
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( xField.iKind != eLK_Var || xField.iWireType == m_iStringSym ) {
+				return false;
 			}
 		}
+		return true;
+	}
 
-		PTContainer *pParent = pStart->get_parent();
-		if( pParent ) {
-			return _findBaseNode( sName, pParent );
+	static unsigned int _elemSize( const SLayoutField& xField )
+	{
+		if( xField.iArrLen == SYM_EMPTY ) {
+			return xField.iWireSize;
 		}
-		return nullptr;
+		return xField.iArrCount ? xField.iWireSize / xField.iArrCount : 0;
 	}
 
-	void _genMsgCtx( PTXMsgNBase* pNode, eStage iStage )
+	// End of the run of fields from iBegin that can be copied as one block.
+	//  Each is fixed-size, no element is wider than the first one's, and
+	//  each starts at a wire offset that is a multiple of its element size.
+	//  Since the first member is aligned, a compiler then has no reason to
+	//  pad between the members, so they sit in memory as on the wire.
+	size_t _blockEnd( const SLayout& xLayout, size_t iBegin, size_t iEnd )
 	{
-		if( iStage == eStage_MEMBERS || iStage == eStage_SER || iStage == eStage_UNSER || iStage == eStage_GETSET ) {
-			_genInherits( pNode, iStage );
-			_genContainer( pNode, iStage );
-		} else {
-			throw GenException( pNode, "message context during incorrect stage" );
+		unsigned int iAlign = _elemSize( xLayout.vFields[iBegin] );
+		unsigned int iOffset = 0;
+		size_t i = iBegin;
+		for( ; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			unsigned int iElem = _elemSize( xField );
+			if( xField.iKind != eLK_Var || !xField.bFixed || iElem == 0 || iElem > iAlign || iOffset % iElem != 0 ) {
+				break;
+			}
+			iOffset += xField.iWireSize;
 		}
+		return i;
 	}
 
-	void _genInherits( PTXMsgNBase *pNode, eStage iStage )
+	// One copy for the fields [iBegin,iEnd), guarded by a static_assert
+	//  that their members really are laid out as on the wire
+	void _genBlock( const SLayout& xLayout, size_t iBegin, size_t iEnd, eStage iStage )
 	{
-		for( auto i = pNode->get_inherits().begin(); i != pNode->get_inherits().end(); ++i ) {
-			PTXMsgNBase *pBase = _findBaseNode( *i, pNode );
-			if( !pBase ) {
-				throw GenException( pNode, "could not find inherited base definition" );
+		const SLayoutField& xFirst = xLayout.vFields[iBegin];
+		const SLayoutField& xLast = xLayout.vFields[iEnd - 1];
+		unsigned int iSize = 0;
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			iSize += xLayout.vFields[i].iWireSize;
+		}
+		std::string sFirst = _getVarName( xFirst.iNode );
+
+		if( iStage == eStage_SER ) {
+			std::string sClass = xFirst.iDepth == 0 ? std::string("pak_") + m_pAst->name(xLayout.iMessage) : _getListPath( m_pAst->parent(xFirst.iNode) );
+			_outTxt( "static_assert( offsetof(%s, %s) - offsetof(%s, %s) == %u, \"%s: members do not match the wire layout\" );\n",
+				sClass.c_str(), _getVarName(xLast.iNode).c_str(), sClass.c_str(), sFirst.c_str(), iSize - xLast.iWireSize, sClass.c_str() );
+			if( m_bUnchecked ) {
+				_outTxt( "::net::encoding::put_block( &vars.%s, %u, data, pos );\n", sFirst.c_str(), iSize );
+			} else {
+				_outTxt( "::net::encoding::write_block( &vars.%s, %u, data, pos, max_len );\n", sFirst.c_str(), iSize );
 			}
+		} else if( m_bUnchecked ) {
+			_outTxt( "::net::encoding::get_block( &vars.%s, %u, data, pos );\n", sFirst.c_str(), iSize );
+		} else {
+			_outTxt( "::net::encoding::read_block( &vars.%s, %u, data, pos, max_len );\n", sFirst.c_str(), iSize );
+		}
+	}
+
+	void _genMsgCtx( const SLayout& xLayout, eStage iStage )
+	{
+		static const ePhase s_aiPhases[] = { ePhase_Generate, ePhase_GenMembers, ePhase_GenSer, ePhase_GenUnser, ePhase_GenGetSet };
+		IdlProfile::Scope xScope( m_pProfile, s_aiPhases[iStage < 5 ? iStage : 0] );
 
-			_genMsgCtx( pBase, iStage );
+		if( iStage == eStage_MEMBERS || iStage == eStage_SER || iStage == eStage_UNSER || iStage == eStage_GETSET ) {
+			_genFields( xLayout, 0, xLayout.vFields.size(), iStage );
+		} else {
+			throw GenException( xLayout.iMessage, "message context during incorrect stage" );
 		}
 	}
 
-	void _genMessage( PTMessage *pNode, eStage iStage )
+	void _genMessage( AstIdx iNode, eStage iStage )
 	{
-		if( iStage == eStage_MAIN ) {
-			_outTxt( "class pak_%s : packet {\n", pNode->get_name().c_str() );
+		if( iStage == eStage_MAIN && !_reached(iNode) ) {
+			_skipMessage( );
+		} else if( iStage == eStage_MAIN && m_pSplice ) {
+			const SGenMessage& xMsg = (*m_pSplice)[m_iSpliceNext++];
+			const IdlOutput& xText = (*m_pWorkers)[xMsg.iWorker]->m_xOut;
+			m_xOut.append( xText.data() + xMsg.iOffset, xMsg.iLength );
+		} else if( iStage == eStage_MAIN ) {
+			const SLayout& xLayout = *m_pLayouts->find( iNode );
+			if( xLayout.iBadBase != AST_NONE ) {
+				throw GenException( xLayout.iBadBase, "could not find inherited base definition" );
+			}
+
+			_outTxt( "class pak_%s : packet {\n", m_pAst->name(iNode) );
 			_outTabs( +1 );
 			{
 				_outTxt( "private:\n" );
 				_outTabs( +1 );
 				{
-					_genMsgCtx( pNode, eStage_MEMBERS );
+					_genMsgCtx( xLayout, eStage_MEMBERS );
 				}
 				_outTabs( -1 );
 
 				_outTxt( "public:\n" );
 				_outTabs( +1 );
 				{
-					_genMsgCtx( pNode, eStage_GETSET );
+					_genMsgCtx( xLayout, eStage_GETSET );
 
 					_outTxt( "\n" );
 
 					unsigned short unType = m_unCommand++;
 					if( unType >= m_unMaxCommand ) {
-						throw GenException( pNode, "too many packets! (all packet types have been used)" );
+						throw GenException( iNode, "too many packets! (all packet types have been used)" );
 					}
 					_outTxt( "static const uint16 type_id = 0x%04x;\n", unType );
+					_genWireSizes( xLayout );
+
+					if( m_bSplit ) {
+						_outTxt( "size_t serialized_size( ) const;\n" );
+						_outTxt( "size_t serialize( char *data, int max_len ) const;\n" );
+						_outTxt( "void unserialize( char *data, int max_len );\n" );
+						_genSplitBodies( xLayout );
+					} else {
+						_genSerializers( xLayout, "" );
+					}
+				}
+				_outTabs( -1 );
+			}
+			_outTabs( -1 );
+			_outTxt( "};\n" );
+
+			if( m_bViews ) {
+				IdlProfile::Scope xScope( m_pProfile, ePhase_GenViews );
+				_genView( xLayout, 0, xLayout.vFields.size(), (std::string("view_") + m_pAst->name(iNode)).c_str() );
+			}
+		} else {
+			throw GenException( iNode, "message during incorrect stage" );
+		}
+	}
+
+	// Indices of the vars and lists directly in [iBegin,iEnd); bLen is set
+	//  when a string or list among them needs max_len to be skipped
+	void _viewFields( const SLayout& xLayout, size_t iBegin, size_t iEnd, std::vector<size_t>& viFields, bool& bLists, bool& bLen )
+	{
+		bLists = false;
+		bLen = false;
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( xField.iKind == eLK_List || xField.iKind == eLK_Var ) {
+				viFields.push_back( i );
+			}
+			if( xField.iKind == eLK_List ) {
+				bLists = true;
+				bLen = true;
+				i = xField.iListEnd;
+			} else if( xField.iKind == eLK_Var && xField.iWireType == m_iStringSym ) {
+				bLen = true;
+			}
+		}
+	}
+
+	// view_X, a read-only view of an X on the wire, or the view of one
+	//  list element for [iBegin,iEnd) at a nested depth. parse() walks the
+	//  buffer once, noting where each field starts in m_aiPos, so every
+	//  accessor after it reads in place with no checks and no copies. The
+	//  buffer must outlive the view. In split output parse() and _parse()
+	//  are only declared here; _genViewBodies() defines them.
+	void _genView( const SLayout& xLayout, size_t iBegin, size_t iEnd, const char *pcClass )
+	{
+		bool bTop = iBegin == 0;
+		bool bLists;
+		bool bLen;
+		std::vector<size_t> viFields;
+		_viewFields( xLayout, iBegin, iEnd, viFields, bLists, bLen );
+
+		_outTxt( "class %s {\n", pcClass );
+		_outTabs( +1 );
+		{
+			_outTxt( "private:\n" );
+			_outTabs( +1 );
+			_outTxt( "const char *m_pcData;\n" );
+			if( bLists ) {
+				_outTxt( "int m_iMaxLen;\n" );
+			}
+			_outTxt( "size_t m_aiPos[%u];\n", (unsigned)viFields.size() + 1 );
+			_outTabs( -1 );
+
+			_outTxt( "public:\n" );
+			_outTabs( +1 );
+			for( size_t k = 0; k < viFields.size(); ++k ) {
+				const SLayoutField& xField = xLayout.vFields[viFields[k]];
+				if( xField.iKind == eLK_List ) {
+					_genView( xLayout, viFields[k] + 1, xField.iListEnd, m_pAst->name(xField.iNode) );
+				}
+			}
+
+			if( bTop ) {
+				_outTxt( "static const uint16 type_id = pak_%s::type_id;\n", m_pAst->name(xLayout.iMessage) );
+			}
+			if( m_bSplit ) {
+				if( bTop ) {
+					_outTxt( "bool parse( const char *data, int len );\n" );
+				}
+				// Not for callers; enclosing views and list_view parse with it
+				_outTxt( "size_t _parse( const char *data, size_t pos, int max_len );\n" );
+			} else {
+				_genViewParse( xLayout, viFields, bTop, bLists, bLen, "" );
+			}
+			_outTxt( "size_t _end( ) const { return m_aiPos[%u]; }\n", (unsigned)viFields.size() );
+
+			for( size_t k = 0; k < viFields.size(); ++k ) {
+				_genViewGet( xLayout.vFields[viFields[k]], (unsigned)k );
+			}
+			_outTabs( -1 );
+		}
+		_outTabs( -1 );
+		_outTxt( "};\n" );
+	}
+
+	// parse() for a message's view, and _parse() for it or a list element's,
+	//  named with pcScope ("view_X::Slot::") when written outside the class
+	void _genViewParse( const SLayout& xLayout, const std::vector<size_t>& viFields, bool bTop, bool bLists, bool bLen, const char *pcScope )
+	{
+		if( bTop ) {
+			_outTxt( "bool %sparse( const char *data, int len ) {\n", pcScope );
+			_outTabs( +1 );
+			_outTxt( "return len >= 0 && _parse( data, 0, len ) <= (size_t)len;\n" );
+			_outTabs( -1 );
+			_outTxt( "}\n" );
+		}
+
+		// A view of fixed-size fields only has no use for max_len
+		_outTxt( "size_t %s_parse( const char *data, size_t pos, int%s ) {\n", pcScope, bLen ? " max_len" : "" );
+		_outTabs( +1 );
+		{
+			_outTxt( "m_pcData = data;\n" );
+			if( bLists ) {
+				_outTxt( "m_iMaxLen = max_len;\n" );
+			}
+			for( size_t k = 0; k < viFields.size(); ++k ) {
+				_outTxt( "m_aiPos[%u] = pos;\n", (unsigned)k );
+				_genViewSkip( xLayout, viFields[k] );
+			}
+			_outTxt( "m_aiPos[%u] = pos;\n", (unsigned)viFields.size() );
+			_outTxt( "return pos;\n" );
+		}
+		_outTabs( -1 );
+		_outTxt( "}\n" );
+	}
+
+	// Out-of-line parse() and _parse() of a view and its list element views
+	void _genViewBodies( const SLayout& xLayout, size_t iBegin, size_t iEnd, const std::string& sScope )
+	{
+		bool bLists;
+		bool bLen;
+		std::vector<size_t> viFields;
+		_viewFields( xLayout, iBegin, iEnd, viFields, bLists, bLen );
+
+		for( size_t k = 0; k < viFields.size(); ++k ) {
+			const SLayoutField& xField = xLayout.vFields[viFields[k]];
+			if( xField.iKind == eLK_List ) {
+				_genViewBodies( xLayout, viFields[k] + 1, xField.iListEnd, sScope + m_pAst->name(xField.iNode) + "::" );
+			}
+		}
+		_genViewParse( xLayout, viFields, iBegin == 0, bLists, bLen, sScope.c_str() );
+	}
+
+	// Moves pos past the field at iIdx in a view's _parse()
+	void _genViewSkip( const SLayout& xLayout, size_t iIdx )
+	{
+		const SLayoutField& xField = xLayout.vFields[iIdx];
+		if( xField.iKind == eLK_List ) {
+			size_t iBodyEnd = xField.iListEnd;
+			if( _wireClass( xLayout, iIdx + 1, iBodyEnd ) != eWire_Unbounded ) {
+				_outTxt( "pos = ::net::encoding::skip_block_list( data, pos, %s, max_len );\n", _constSize( xLayout, iIdx + 1, iBodyEnd, false ).c_str() );
+			} else {
+				_outTxt( "pos = ::net::encoding::skip_list<%s>( data, pos, %s, max_len );\n",
+					m_pAst->name(xField.iNode), _constSize( xLayout, iIdx + 1, iBodyEnd, true ).c_str() );
+			}
+		} else if( xField.iWireType == m_iStringSym ) {
+			if( xField.iArrLen == SYM_EMPTY ) {
+				_outTxt( "pos = ::net::encoding::skip_string( data, pos, max_len );\n" );
+			} else {
+				_outTxt( "pos = ::net::encoding::skip_strings( data, pos, %s, max_len );\n", m_pAst->str(xField.iArrLen) );
+			}
+		} else {
+			_outTxt( "pos += %s;\n", _wireSizeExpr( xField ).c_str() );
+		}
+	}
+
+	void _genViewGet( const SLayoutField& xField, unsigned int k )
+	{
+		const char *pcName = m_pAst->name( xField.iNode );
+		const char *pcType = m_pAst->str( xField.iType );
+		bool bArray = xField.iArrLen != SYM_EMPTY;
+
+		if( xField.iKind == eLK_List ) {
+			_outTxt( "::net::encoding::list_view<%s> get_%s( ) const { return ::net::encoding::list_view<%s>( m_pcData, m_aiPos[%u], m_iMaxLen ); }\n",
+				pcName, pcName, pcName, k );
+		} else if( xField.iWireType == m_iStringSym && bArray ) {
+			_outTxt( "std::string_view get_%s( size_t iIdx ) const { return ::net::encoding::string_at( m_pcData + m_aiPos[%u], iIdx ); }\n", pcName, k );
+		} else if( xField.iWireType == m_iStringSym ) {
+			_outTxt( "std::string_view get_%s( ) const { return std::string_view( m_pcData + m_aiPos[%u], m_aiPos[%u] - m_aiPos[%u] - 1 ); }\n",
+				pcName, k, k + 1, k );
+		} else if( bArray ) {
+			_outTxt( "::net::encoding::array_view<%s> get_%s( ) const { return ::net::encoding::array_view<%s>( m_pcData + m_aiPos[%u], %s ); }\n",
+				pcType, pcName, pcType, k, m_pAst->str(xField.iArrLen) );
+		} else {
+			_outTxt( "%s get_%s( ) const { return ::net::encoding::peek<%s>( m_pcData + m_aiPos[%u] ); }\n", pcType, pcName, pcType, k );
+		}
+	}
+
+	eWireClass _wireClass( const SLayout& xLayout, size_t iBegin, size_t iEnd )
+	{
+		eWireClass iClass = eWire_Fixed;
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( xField.iKind != eLK_Var || xField.iWireType == m_iStringSym ) {
+				return eWire_Unbounded;
+			}
+			if( !xField.bFixed ) {
+				iClass = eWire_Bounded;
+			}
+		}
+		return iClass;
+	}
+
+	// Wire size of a var as a constant expression; "" for a string
+	std::string _wireSizeExpr( const SLayoutField& xField )
+	{
+		if( xField.bFixed ) {
+			char acSize[16];
+			sprintf( acSize, "%u", xField.iWireSize );
+			return acSize;
+		}
+		if( xField.iWireType == m_iStringSym ) {
+			return "";
+		}
+
+		std::string sSize = std::string("sizeof(") + m_pAst->str(xField.iType) + ")";
+		if( xField.iArrLen != SYM_EMPTY ) {
+			sSize += std::string(" * ") + m_pAst->str(xField.iArrLen);
+		}
+		return sSize;
+	}
+
+	// Summed wire size of the vars in [iBegin,iEnd) at one list depth, as a
+	//  constant expression. A list counts only its element count, and a
+	//  string nothing unless bMin asks for the one byte each needs at the
+	//  least.
+	std::string _constSize( const SLayout& xLayout, size_t iBegin, size_t iEnd, bool bMin )
+	{
+		unsigned int iFixed = 0;
+		std::string sTerms;
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( xField.iKind == eLK_List ) {
+				iFixed += LIST_COUNT_SIZE;
+				i = xField.iListEnd;
+				continue;
+			}
+			if( xField.iKind != eLK_Var ) {
+				continue;
+			}
+
+			std::string sSize = _wireSizeExpr( xField );
+			if( sSize.empty() && bMin ) {
+				if( xField.iArrLen == SYM_EMPTY ) {
+					iFixed++;
+				} else if( xField.iArrCount ) {
+					iFixed += xField.iArrCount;
+				} else {
+					sSize = m_pAst->str( xField.iArrLen );
+				}
+			}
+			if( xField.bFixed ) {
+				iFixed += xField.iWireSize;
+			} else if( !sSize.empty() ) {
+				sTerms += ( sTerms.empty() ? "" : " + " ) + sSize;
+			}
+		}
+
+		char acFixed[16];
+		sprintf( acFixed, "%u", iFixed );
+		if( sTerms.empty() ) {
+			return acFixed;
+		}
+		return iFixed ? acFixed + ( " + " + sTerms ) : sTerms;
+	}
 
-					_outTxt( "size_t serialize( char *data, int max_len ) const {\n" );
+	void _genWireSizes( const SLayout& xLayout )
+	{
+		std::string sMin = _constSize( xLayout, 0, xLayout.vFields.size(), true );
+		_outTxt( "static constexpr size_t min_wire_size = %s;\n", sMin.c_str() );
+		if( _wireClass( xLayout, 0, xLayout.vFields.size() ) == eWire_Unbounded ) {
+			_outTxt( "static constexpr size_t max_wire_size = ~(size_t)0;\n" );
+		} else {
+			_outTxt( "static constexpr size_t max_wire_size = min_wire_size;\n" );
+		}
+	}
+
+	// Adds the sizes of the strings and lists in [iBegin,iEnd) to size;
+	//  the caller has already added the constant part
+	void _genSize( const SLayout& xLayout, size_t iBegin, size_t iEnd )
+	{
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			const SLayoutField& xField = xLayout.vFields[i];
+			if( xField.iKind == eLK_List ) {
+				AstIdx iNode = xField.iNode;
+				size_t iBodyEnd = xField.iListEnd;
+				std::string sElem = _constSize( xLayout, i + 1, iBodyEnd, false );
+				if( _wireClass( xLayout, i + 1, iBodyEnd ) != eWire_Unbounded ) {
+					_outTxt( "size += vars.%s.size( ) * ( %s );\n", _getListName(iNode).c_str(), sElem.c_str() );
+				} else {
+					_outTxt( "for( auto i =  vars.%s.begin(); i != vars.%s.end(); ++i ) {\n", _getListName(iNode).c_str(), _getListName(iNode).c_str() );
 					_outTabs( +1 );
 					{
-						_outTxt( "size_t pos = 0;\n" );
-						_outTxt( "const pak_%s& vars = *this;\n", pNode->get_name().c_str() );
-						_genMsgCtx( pNode, eStage_SER );
-						_outTxt( "return pos;\n" );
+						_outTxt( "const %s& vars = *i;\n", _getListPath(iNode).c_str() );
+						if( sElem != "0" ) {
+							_outTxt( "size += %s;\n", sElem.c_str() );
+						}
+						_genSize( xLayout, i + 1, iBodyEnd );
 					}
 					_outTabs( -1 );
 					_outTxt( "}\n" );
-
-					_outTxt( "void unserialize( char *data, int max_len ) {\n" );
+				}
+				i = iBodyEnd;
+			} else if( xField.iKind == eLK_Var && xField.iWireType == m_iStringSym ) {
+				if( xField.iArrLen == SYM_EMPTY ) {
+					_outTxt( "size += vars.%s.size( ) + 1;\n", _getVarName(xField.iNode).c_str() );
+				} else {
+					_outTxt( "for( size_t j = 0; j < %s; ++j ) {\n", m_pAst->str(xField.iArrLen) );
 					_outTabs( +1 );
-					{
-						_outTxt( "size_t pos = 0;\n" );
-						_outTxt( "pak_%s& vars = *this;\n", pNode->get_name().c_str() );
-						_genMsgCtx( pNode, eStage_UNSER );
-					}
+					_outTxt( "size += vars.%s[j].size( ) + 1;\n", _getVarName(xField.iNode).c_str() );
 					_outTabs( -1 );
 					_outTxt( "}\n" );
 				}
-				_outTabs( -1 );
 			}
-			_outTabs( -1 );
-			_outTxt( "};\n" );
+		}
+	}
+
+	// serialized_size(), serialize() and unserialize() with their bodies,
+	//  named with pcScope ("pak_X::") when they are written outside the
+	//  class. A message that is not unbounded checks its size against
+	//  max_len once and then stores and loads without further checks.
+	void _genSerializers( const SLayout& xLayout, const char *pcScope )
+	{
+		const char *pcName = m_pAst->name( xLayout.iMessage );
+		bool bChecked = _wireClass( xLayout, 0, xLayout.vFields.size() ) != eWire_Unbounded;
+
+		_outTxt( "size_t %sserialized_size( ) const {\n", pcScope );
+		_outTabs( +1 );
+		if( bChecked ) {
+			_outTxt( "return max_wire_size;\n" );
 		} else {
-			throw GenException( pNode, "message during incorrect stage" );
+			IdlProfile::Scope xScope( m_pProfile, ePhase_GenSer );
+			_outTxt( "size_t size = %s;\n", _constSize( xLayout, 0, xLayout.vFields.size(), false ).c_str() );
+			_outTxt( "const pak_%s& vars = *this;\n", pcName );
+			_genSize( xLayout, 0, xLayout.vFields.size() );
+			_outTxt( "return size;\n" );
 		}
+		_outTabs( -1 );
+		_outTxt( "}\n" );
+
+		m_bUnchecked = bChecked;
+
+		_outTxt( "size_t %sserialize( char *data, int max_len ) const {\n", pcScope );
+		_outTabs( +1 );
+		{
+			if( bChecked ) {
+				_outTxt( "if( !::net::encoding::fits( 0, max_wire_size, max_len ) ) {\n" );
+				_outTabs( +1 );
+				_outTxt( "return max_wire_size;\n" );
+				_outTabs( -1 );
+				_outTxt( "}\n" );
+			}
+			_outTxt( "size_t pos = 0;\n" );
+			_outTxt( "const pak_%s& vars = *this;\n", pcName );
+			_genMsgCtx( xLayout, eStage_SER );
+			_outTxt( "return pos;\n" );
+		}
+		_outTabs( -1 );
+		_outTxt( "}\n" );
+
+		_outTxt( "void %sunserialize( char *data, int max_len ) {\n", pcScope );
+		_outTabs( +1 );
+		{
+			if( bChecked ) {
+				_outTxt( "if( !::net::encoding::fits( 0, max_wire_size, max_len ) ) {\n" );
+				_outTabs( +1 );
+				_outTxt( "return;\n" );
+				_outTabs( -1 );
+				_outTxt( "}\n" );
+			}
+			_outTxt( "size_t pos = 0;\n" );
+			_outTxt( "pak_%s& vars = *this;\n", pcName );
+			_genMsgCtx( xLayout, eStage_UNSER );
+		}
+		_outTabs( -1 );
+		_outTxt( "}\n" );
+
+		m_bUnchecked = false;
 	}
 
-	void _genBase( PTBase *pNode, eStage iStage )
+	void _genBase( AstIdx iNode, eStage iStage )
 	{
 		// these are only inline-composited into messages, and are generated from there
 	}
 
-	void _genList( PTList *pNode, eStage iStage )
+	// Wire size of an element of the list at iIdx when the vector's storage
+	//  can be copied as it is: the elements make up one block, and their
+	//  size is a multiple of the first field's element size, so a compiler
+	//  adds no padding at the end either. 0 otherwise.
+	unsigned int _listBlockSize( const SLayout& xLayout, size_t iIdx )
+	{
+		size_t iBegin = iIdx + 1;
+		size_t iEnd = xLayout.vFields[iIdx].iListEnd;
+		if( iBegin == iEnd || !_isPlain( xLayout, iBegin, iEnd ) || _blockEnd( xLayout, iBegin, iEnd ) != iEnd ) {
+			return 0;
+		}
+
+		unsigned int iSize = 0;
+		for( size_t i = iBegin; i < iEnd; ++i ) {
+			iSize += xLayout.vFields[i].iWireSize;
+		}
+		return iSize % _elemSize( xLayout.vFields[iBegin] ) == 0 ? iSize : 0;
+	}
+
+	void _genList( const SLayout& xLayout, size_t iIdx, eStage iStage )
 	{
+		AstIdx iNode = xLayout.vFields[iIdx].iNode;
+		size_t iBodyEnd = xLayout.vFields[iIdx].iListEnd;
+
 		if( iStage == eStage_MEMBERS ) {
-			_outTxt( "class %s {\n", pNode->get_name().c_str() );
+			_outTxt( "class %s {\n", m_pAst->name(iNode) );
 			_outTabs( +1 );
 			{
-				std::string vSerializer = _getSerializer( pNode );
+				std::string vSerializer = _getSerializer( iNode );
 				if( vSerializer != "" ) {
 					_outTxt( "friend class %s;\n", vSerializer.c_str() );
 				}
@@ -292,99 +825,595 @@ public:
 				_outTxt( "private:\n" );
 				_outTabs( +1 );
 				{
-					_genContainer( pNode, iStage );
+					_genFields( xLayout, iIdx + 1, iBodyEnd, iStage );
 				}
 				_outTabs( -1 );
 
 				_outTxt( "public:\n" );
 				_outTabs( +1 );
 				{
-					_genContainer( pNode, eStage_GETSET );
+					_genFields( xLayout, iIdx + 1, iBodyEnd, eStage_GETSET );
 				}
 				_outTabs( -1 );
 			}
 			_outTabs( -1 );
 			_outTxt( "};\n" );
-			_outTxt( "std::vector<%s> %s;\n", pNode->get_name().c_str(), _getListName(pNode).c_str() );
+			_outTxt( "std::vector<%s> %s;\n", m_pAst->name(iNode), _getListName(iNode).c_str() );
 		} else if( iStage == eStage_SER ) {
-			_outTxt( "for( auto i =  vars.%s.begin(); i != vars.%s.end(); ++i ) {\n", _getListName(pNode).c_str(), _getListName(pNode).c_str() );
+			_outTxt( "::net::encoding::write_count( vars.%s, data, pos, max_len );\n", _getListName(iNode).c_str() );
+			unsigned int iElemSize = _listBlockSize( xLayout, iIdx );
+			if( iElemSize ) {
+				_outTxt( "static_assert( sizeof(%s) == %u, \"%s: elements do not match the wire layout\" );\n",
+					_getListPath(iNode).c_str(), iElemSize, _getListPath(iNode).c_str() );
+				_outTxt( "::net::encoding::write_block( vars.%s.data( ), vars.%s.size( ) * %u, data, pos, max_len );\n",
+					_getListName(iNode).c_str(), _getListName(iNode).c_str(), iElemSize );
+				return;
+			}
+
+			_outTxt( "for( auto i =  vars.%s.begin(); i != vars.%s.end(); ++i ) {\n", _getListName(iNode).c_str(), _getListName(iNode).c_str() );
 			_outTabs( +1 );
 			{
-				_outTxt( "const %s& vars = *i;\n", _getListPath(pNode).c_str() );
-				_genContainer( pNode, iStage );
+				_outTxt( "const %s& vars = *i;\n", _getListPath(iNode).c_str() );
+				_genFields( xLayout, iIdx + 1, iBodyEnd, iStage );
 			}
 			_outTabs( -1 );
 			_outTxt( "}\n" );
 		} else if( iStage == eStage_UNSER ) {
-			_outTxt( "for( auto i =  vars.%s.begin(); i != vars.%s.end(); ++i ) {\n", _getListName(pNode).c_str(), _getListName(pNode).c_str() );
+			std::string sMin = _constSize( xLayout, iIdx + 1, iBodyEnd, true );
+			_outTxt( "::net::encoding::read_count( vars.%s, %s, data, pos, max_len );\n", _getListName(iNode).c_str(), sMin.c_str() );
+			unsigned int iElemSize = _listBlockSize( xLayout, iIdx );
+			if( iElemSize ) {
+				_outTxt( "::net::encoding::read_block( vars.%s.data( ), vars.%s.size( ) * %u, data, pos, max_len );\n",
+					_getListName(iNode).c_str(), _getListName(iNode).c_str(), iElemSize );
+				return;
+			}
+
+			_outTxt( "for( auto i =  vars.%s.begin(); i != vars.%s.end(); ++i ) {\n", _getListName(iNode).c_str(), _getListName(iNode).c_str() );
 			_outTabs( +1 );
 			{
-				_outTxt( "%s& vars = *i;\n", _getListPath(pNode).c_str() );
-				_genContainer( pNode, iStage );
+				_outTxt( "%s& vars = *i;\n", _getListPath(iNode).c_str() );
+				_genFields( xLayout, iIdx + 1, iBodyEnd, iStage );
 			}
 			_outTabs( -1 );
 			_outTxt( "}\n" );
 		} else if( iStage == eStage_GETSET ) {
-			//_outTxt( "%s get_%s( ) const { return %s; }", pNode->get_type().c_str(), pNode->get_name().c_str(), _getVarName(pNode).c_str() );
+			//_outTxt( "%s get_%s( ) const { return %s; }", m_pAst->var_type(iNode), m_pAst->name(iNode), _getVarName(iNode).c_str() );
 
-			//_outTxt( "void set_%s( %s val ) const { %s = val; }", pNode->get_name().c_str(), pNode->get_type().c_str(), _getVarName(pNode).c_str() );
+			//_outTxt( "void set_%s( %s val ) const { %s = val; }", m_pAst->name(iNode), m_pAst->var_type(iNode), _getVarName(iNode).c_str() );
 		} else {
-			throw GenException( pNode, "list during incorrect stage" );
+			throw GenException( iNode, "list during incorrect stage" );
 		}
 	}
 
-	void _genVar( PTVar *pNode, eStage iStage )
+	void _genVar( const SLayoutField& xField, eStage iStage )
 	{
+		AstIdx iNode = xField.iNode;
+		const char *pcType = m_pAst->str( xField.iType );
+		const char *pcName = m_pAst->name( iNode );
+		const char *pcArrLen = m_pAst->str( xField.iArrLen );
+		bool bArray = xField.iArrLen != SYM_EMPTY;
+
 		if( iStage == eStage_MEMBERS ) {
-			if( pNode->get_arrlen() != "" ) {
-				_outTxt( "%s %s[%s];\n", pNode->get_type().c_str(), _getVarName(pNode).c_str(), pNode->get_arrlen().c_str() );
+			if( bArray ) {
+				_outTxt( "%s %s[%s];\n", pcType, _getVarName(iNode).c_str(), pcArrLen );
+			} else {
+				_outTxt( "%s %s;\n", pcType, _getVarName(iNode).c_str() );
+			}
+		} else if( iStage == eStage_SER && m_bUnchecked ) {
+			if( bArray ) {
+				_outTxt( "::net::encoding::put_arr( vars.%s, %s, data, pos );\n", _getVarName(iNode).c_str(), pcArrLen );
+			} else {
+				_outTxt( "::net::encoding::put( vars.%s, data, pos );\n", _getVarName(iNode).c_str() );
+			}
+		} else if( iStage == eStage_UNSER && m_bUnchecked ) {
+			if( bArray ) {
+				_outTxt( "::net::encoding::get_arr( vars.%s, %s, data, pos );\n", _getVarName(iNode).c_str(), pcArrLen );
 			} else {
-				_outTxt( "%s %s;\n", pNode->get_type().c_str(), _getVarName(pNode).c_str() );
+				_outTxt( "::net::encoding::get( vars.%s, data, pos );\n", _getVarName(iNode).c_str() );
 			}
 		} else if( iStage == eStage_SER ) {
-			if( pNode->get_arrlen() != "" ) {
-				_outTxt( "::net::encoding::write_arr( vars.%s, %s, data, pos, max_len );\n", _getVarName(pNode).c_str(), pNode->get_arrlen().c_str() );
+			if( bArray ) {
+				_outTxt( "::net::encoding::write_arr( vars.%s, %s, data, pos, max_len );\n", _getVarName(iNode).c_str(), pcArrLen );
 			} else {
-				_outTxt( "::net::encoding::write( vars.%s, data, pos, max_len );\n", _getVarName(pNode).c_str() );
+				_outTxt( "::net::encoding::write( vars.%s, data, pos, max_len );\n", _getVarName(iNode).c_str() );
 			}
 		} else if( iStage == eStage_UNSER ) {
-			if( pNode->get_arrlen() != "" ) {
-				_outTxt( "::net::encoding::read_arr( vars.%s, %s, data, pos, max_len );\n", _getVarName(pNode).c_str(), pNode->get_arrlen().c_str() );
+			if( bArray ) {
+				_outTxt( "::net::encoding::read_arr( vars.%s, %s, data, pos, max_len );\n", _getVarName(iNode).c_str(), pcArrLen );
 			} else {
-				_outTxt( "::net::encoding::read( vars.%s, data, pos, max_len );\n", _getVarName(pNode).c_str() );
+				_outTxt( "::net::encoding::read( vars.%s, data, pos, max_len );\n", _getVarName(iNode).c_str() );
 			}
 		} else if( iStage == eStage_GETSET ) {
-			if( pNode->get_arrlen() != "" ) {
-				_outTxt( "%s get_%s( int iIdx ) const { return %s[iIdx]; }\n", pNode->get_type().c_str(), pNode->get_name().c_str(), _getVarName(pNode).c_str() );
-				_outTxt( "void set_%s( int iIdx, %s val ) { %s[iIdx] = val; }\n", pNode->get_name().c_str(), pNode->get_type().c_str(), _getVarName(pNode).c_str() );
+			if( bArray ) {
+				_outTxt( "%s get_%s( int iIdx ) const { return %s[iIdx]; }\n", pcType, pcName, _getVarName(iNode).c_str() );
+				_outTxt( "void set_%s( int iIdx, %s val ) { %s[iIdx] = val; }\n", pcName, pcType, _getVarName(iNode).c_str() );
 			} else {
-				_outTxt( "%s get_%s( ) const { return %s; }\n", pNode->get_type().c_str(), pNode->get_name().c_str(), _getVarName(pNode).c_str() );
-				_outTxt( "void set_%s( %s val ) { %s = val; }\n", pNode->get_name().c_str(), pNode->get_type().c_str(), _getVarName(pNode).c_str() );
+				_outTxt( "%s get_%s( ) const { return %s; }\n", pcType, pcName, _getVarName(iNode).c_str() );
+				_outTxt( "void set_%s( %s val ) { %s = val; }\n", pcName, pcType, _getVarName(iNode).c_str() );
 			}
 		} else {
-			throw GenException( pNode, "var during incorrect stage" );
+			throw GenException( iNode, "var during incorrect stage" );
 		}
 	}
 
-	void _gen( PTElement *pNode, eStage iStage )
+	void _gen( AstIdx iNode, eStage iStage )
 	{
-#define LAZYMAN(x) if( pNode->type() == ePT_##x ) { _gen##x((PT##x*)pNode,iStage); } 
+		switch( m_pAst->type(iNode) ) {
+#define LAZYMAN(x) case ePT_##x: _gen##x(iNode,iStage); break;
 		LAZYMAN(Root)
-		else LAZYMAN(Enum)
-		else LAZYMAN(Typedef)
-		else LAZYMAN(Namespace)
-		else LAZYMAN(Message)
-		else LAZYMAN(Base)
-		else LAZYMAN(List)
-		else LAZYMAN(Var)
+		LAZYMAN(Enum)
+		LAZYMAN(Typedef)
+		LAZYMAN(Namespace)
+		LAZYMAN(Message)
+		LAZYMAN(Base)
 #undef LAZYMAN
+		default: break;
+		}
+	}
+
+	// type_ids are handed out from unFirst upward and must stay below unMax
+	void set_command_range( unsigned short unFirst, unsigned short unMax )
+	{
+		m_unCommand = unFirst;
+		m_unMaxCommand = unMax;
+	}
+
+	bool _reached( AstIdx iNode ) const
+	{
+		return m_vbReached.empty() || m_vbReached[iNode];
+	}
+
+	// An unreached message still takes its type_id, so every other message
+	//  keeps the one it has when the whole schema is generated
+	void _skipMessage( )
+	{
+		m_unCommand++;
+		if( m_pSplice ) {
+			m_iSpliceNext++;
+		}
+	}
+
+	void _skipMessages( AstIdx iNode )
+	{
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			if( m_pAst->type(*i) == ePT_Message ) {
+				_skipMessage( );
+			} else if( m_pAst->type(*i) == ePT_Namespace ) {
+				_skipMessages( *i );
+			}
+		}
+	}
+
+	// "ns::inner::Name" for a Message or Namespace
+	std::string _qualifiedName( AstIdx iNode ) const
+	{
+		std::string sName = m_pAst->name( iNode );
+		for( AstIdx i = m_pAst->parent(iNode); i != AST_NONE && i != AST_ROOT; i = m_pAst->parent(i) ) {
+			sName = m_pAst->name(i) + ("::" + sName);
+		}
+		return sName;
+	}
+
+	// A root names a node by its qualified name or any trailing part of
+	//  it, so "Login" and "auth::Login" both find auth::Login
+	bool _matchRoot( const std::string& sRoot, AstIdx iNode ) const
+	{
+		std::string sName = _qualifiedName( iNode );
+		if( sName.size() < sRoot.size() || sName.compare( sName.size() - sRoot.size(), sRoot.size(), sRoot ) != 0 ) {
+			return false;
+		}
+		return sName.size() == sRoot.size() || sName.compare( sName.size() - sRoot.size() - 2, 2, "::" ) == 0;
+	}
+
+	void _reachAll( AstIdx iNode )
+	{
+		m_vbReached[iNode] = true;
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			if( m_pAst->type(*i) == ePT_Message || m_pAst->type(*i) == ePT_Namespace ) {
+				_reachAll( *i );
+			}
+		}
+	}
+
+	// A message can only inherit bases, and its lists are declared inside
+	//  it; both are already inlined into its layout. So the messages
+	//  reached are the roots and everything inside root namespaces, and
+	//  a namespace is kept when it holds one of them or a typedef or enum.
+	bool _reachContainer( AstIdx iNode )
+	{
+		bool bKeep = false;
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			eParseType iType = m_pAst->type( *i );
+			if( iType == ePT_Namespace ) {
+				m_vbReached[*i] = _reachContainer( *i ) || m_vbReached[*i];
+			}
+			if( iType == ePT_Typedef || iType == ePT_Enum ) {
+				m_vbReached[*i] = true;
+			}
+			bKeep = bKeep || m_vbReached[*i];
+		}
+		return bKeep;
+	}
+
+	void _markReached( )
+	{
+		m_vbReached.assign( m_pAst->node_cnt(), false );
+		if( m_vRoots.empty() ) {
+			m_vbReached.clear( );
+			return;
+		}
+
+		for( auto r = m_vRoots.begin(); r != m_vRoots.end(); ++r ) {
+			bool bFound = false;
+			for( AstIdx i = 0; i < m_pAst->node_cnt(); ++i ) {
+				eParseType iType = m_pAst->type( i );
+				if( ( iType == ePT_Message || iType == ePT_Namespace ) && _matchRoot( *r, i ) ) {
+					_reachAll( i );
+					bFound = true;
+				}
+			}
+			if( !bFound ) {
+				std::string sErrStr = "root '" + *r + "' names no message or namespace";
+				throw GenException( AST_ROOT, sErrStr.c_str() );
+			}
+		}
+		_reachContainer( AST_ROOT );
+	}
+
+	// Only the named messages and namespaces, and what they need, are
+	//  generated. type_ids are the same as when the whole schema is
+	//  generated, so binaries built from different roots agree on them.
+	//  An empty list generates everything.
+	void set_roots( const std::vector<std::string>& vRoots )
+	{
+		m_vRoots = vRoots;
+	}
+
+	// Stage timings are added to pProfile on every generate(); nullptr
+	//  turns them off
+	void set_profile( IdlProfile *pProfile )
+	{
+		m_pProfile = pProfile;
+	}
+
+	void _clearFiles( )
+	{
+		for( auto i = m_vFiles.begin(); i != m_vFiles.end(); ++i ) {
+			delete i->pText;
+		}
+		m_vFiles.clear( );
+	}
+
+	// Header and source for top-level namespace sName, created the first
+	//  time the namespace is seen; a namespace that is reopened later in
+	//  the schema carries on in the same pair.
+	size_t _splitFile( const std::string& sName )
+	{
+		std::string sSuffix = "." + sName + ".h";
+		for( size_t i = 0; i < m_vFiles.size(); ++i ) {
+			if( m_vFiles[i].sSuffix == sSuffix ) {
+				return i;
+			}
+		}
+
+		SGenFile xHeader;
+		xHeader.sSuffix = sSuffix;
+		xHeader.pText = new IdlOutput( );
+		xHeader.pText->text( "#pragma once\n#include \"%s.h\"\n\n", m_sSplitBase.c_str() );
+		xHeader.pText->line( "namespace net {\n" );
+		xHeader.pText->indent( +1 );
+		m_vFiles.push_back( xHeader );
+
+		SGenFile xSource;
+		xSource.sSuffix = "." + sName + ".cpp";
+		xSource.pText = new IdlOutput( );
+		xSource.pText->text( "#include \"%s\"\n#include \"%s%s\"\n\n", m_sSplitInclude.c_str(), m_sSplitBase.c_str(), sSuffix.c_str() );
+		xSource.pText->line( "namespace net {\n" );
+		xSource.pText->indent( +1 );
+		m_vFiles.push_back( xSource );
+
+		return m_vFiles.size() - 2;
+	}
+
+	void _genSplitNamespace( AstIdx iNode )
+	{
+		m_iSplitFile = _splitFile( m_pAst->name(iNode) );
+		IdlOutput *pLastOut = m_pOut;
+		m_pOut = m_vFiles[m_iSplitFile].pText;
+
+		_outTxt( "namespace %s {\n", m_pAst->name(iNode) );
+		_outTabs( +1 );
+		_genContainer( iNode, eStage_MAIN );
+		_outTabs( -1 );
+		_outTxt( "};\n" );
+
+		m_pOut = pLastOut;
+	}
+
+	// Writes a message's serializer bodies to the source beside the header
+	//  being generated. The source only reopens namespaces when the
+	//  message's differ from those of the body before it.
+	void _genSplitBodies( const SLayout& xLayout )
+	{
+		AstIdx iMessage = xLayout.iMessage;
+		std::vector<AstIdx> viPath;
+		for( AstIdx i = m_pAst->parent(iMessage); i != AST_NONE && i != AST_ROOT; i = m_pAst->parent(i) ) {
+			viPath.insert( viPath.begin(), i );
+		}
+
+		// Bodies of messages outside any namespace go to <base>.cpp
+		size_t iSource = m_iSplitFile + 1;
+		if( viPath.empty() ) {
+			for( iSource = 0; iSource < m_vFiles.size() && m_vFiles[iSource].sSuffix != ".cpp"; ++iSource ) {
+			}
+			if( iSource == m_vFiles.size() ) {
+				SGenFile xRoot;
+				xRoot.sSuffix = ".cpp";
+				xRoot.pText = new IdlOutput( );
+				xRoot.pText->text( "#include \"%s\"\n#include \"%s.h\"\n\n", m_sSplitInclude.c_str(), m_sSplitBase.c_str() );
+				xRoot.pText->line( "namespace net {\n" );
+				xRoot.pText->indent( +1 );
+				m_vFiles.push_back( xRoot );
+			}
+		}
+
+		SGenFile& xSource = m_vFiles[iSource];
+		IdlOutput *pLastOut = m_pOut;
+		m_pOut = xSource.pText;
+
+		size_t iKeep = 0;
+		while( iKeep < xSource.viOpen.size() && iKeep < viPath.size() && xSource.viOpen[iKeep] == viPath[iKeep] ) {
+			iKeep++;
+		}
+		while( xSource.viOpen.size() > iKeep ) {
+			_outTabs( -1 );
+			_outTxt( "};\n" );
+			xSource.viOpen.pop_back( );
+		}
+		for( size_t i = iKeep; i < viPath.size(); ++i ) {
+			_outTxt( "namespace %s {\n", m_pAst->name(viPath[i]) );
+			_outTabs( +1 );
+			xSource.viOpen.push_back( viPath[i] );
+		}
+
+		std::string sScope = std::string("pak_") + m_pAst->name(iMessage) + "::";
+		_genSerializers( xLayout, sScope.c_str() );
+		if( m_bViews ) {
+			IdlProfile::Scope xScope( m_pProfile, ePhase_GenViews );
+			_genViewBodies( xLayout, 0, xLayout.vFields.size(), std::string("view_") + m_pAst->name(iMessage) + "::" );
+		}
+
+		m_pOut = pLastOut;
+	}
+
+	// Closes every namespace still open in the split files
+	void _finishSplit( )
+	{
+		for( auto i = m_vFiles.begin(); i != m_vFiles.end(); ++i ) {
+			IdlOutput& xText = *i->pText;
+			for( size_t j = 0; j < i->viOpen.size(); ++j ) {
+				xText.indent( -1 );
+				xText.line( "};\n" );
+			}
+			xText.indent( -1 );
+			xText.line( "};\n" );
+		}
+	}
+
+	// Top-level messages in the order _gen() reaches them, with the
+	//  indentation each is written at.
+	void _collectMessages( AstIdx iNode, int iIndent, std::vector<SGenMessage>& vMessages )
+	{
+		eParseType iType = m_pAst->type( iNode );
+		if( iType == ePT_Message ) {
+			SGenMessage xMsg;
+			xMsg.iNode = iNode;
+			xMsg.iIndent = iIndent;
+			xMsg.unType = 0;
+			xMsg.iWorker = 0;
+			xMsg.iOffset = 0;
+			xMsg.iLength = 0;
+			vMessages.push_back( xMsg );
+		} else if( iType == ePT_Root || iType == ePT_Namespace ) {
+			auto xChildren = m_pAst->children( iNode );
+			for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+				_collectMessages( *i, iIndent + 1, vMessages );
+			}
+		}
+	}
+
+	// Each message only reads the resolved tree, so messages are written
+	//  by a pool of worker generators, each into its own buffer, and then
+	//  spliced into place by an ordinary pass over the tree. type_ids are
+	//  handed out in declaration order before any worker starts, and the
+	//  first error in declaration order is the one thrown, so the result
+	//  is the same as a sequential run.
+	void _generateParallel( std::vector<SGenMessage>& vMessages, unsigned int iThreads )
+	{
+		for( size_t i = 0; i < vMessages.size(); ++i ) {
+			unsigned int iType = m_unCommand + (unsigned int)i;
+			vMessages[i].unType = (unsigned short)( iType < m_unMaxCommand ? iType : m_unMaxCommand );
+		}
+
+		std::vector<CppGenerator*> vWorkers;
+		std::vector<IdlProfile> vProfiles( iThreads );
+		for( unsigned int i = 0; i < iThreads; ++i ) {
+			vWorkers.push_back( new CppGenerator( m_pAst, m_pLayouts ) );
+			vWorkers.back()->m_unMaxCommand = m_unMaxCommand;
+			vWorkers.back()->m_pProfile = m_pProfile ? &vProfiles[i] : nullptr;
+			vWorkers.back()->m_vbReached = m_vbReached;
+			vWorkers.back()->m_bViews = m_bViews;
+		}
+
+		// Heap use of each worker on its own thread, from its first message
+		//  to its last; worker 0 is this thread, already seen by generate
+		std::vector<SAllocCounters> vAllocs( iThreads );
+
+		std::atomic<size_t> iNext( 0 );
+		auto fnWorker = [&]( unsigned int iWorker ) {
+			CppGenerator& xGen = *vWorkers[iWorker];
+			SAllocCounters& xAllocs = SAllocCounters::local( );
+			SAllocCounters xStart = xAllocs;
+			xAllocs.iPeak = xAllocs.iLive;
+			for( size_t i = iNext++; i < vMessages.size(); i = iNext++ ) {
+				SGenMessage& xMsg = vMessages[i];
+				xMsg.iWorker = iWorker;
+				xMsg.iOffset = xGen.m_xOut.size( );
+				xGen.m_unCommand = xMsg.unType;
+				xGen.m_xOut.indent( xMsg.iIndent );
+				try {
+					xGen._genMessage( xMsg.iNode, eStage_MAIN );
+				} catch( ... ) {
+					xMsg.pError = std::current_exception( );
+				}
+				xGen.m_xOut.clear_indent( );
+				xMsg.iLength = xGen.m_xOut.size() - xMsg.iOffset;
+			}
+			vAllocs[iWorker].iCount = xAllocs.iCount - xStart.iCount;
+			vAllocs[iWorker].iBytes = xAllocs.iBytes - xStart.iBytes;
+			vAllocs[iWorker].iLive = xAllocs.iLive > xStart.iLive ? xAllocs.iLive - xStart.iLive : 0;
+			vAllocs[iWorker].iPeak = xAllocs.iPeak - xStart.iLive;
+			if( xStart.iPeak > xAllocs.iPeak ) {
+				xAllocs.iPeak = xStart.iPeak;
+			}
+		};
+
+		std::vector<std::thread> vThreads;
+		for( unsigned int i = 1; i < iThreads; ++i ) {
+			vThreads.push_back( std::thread( fnWorker, i ) );
+		}
+		fnWorker( 0 );
+		for( auto i = vThreads.begin(); i != vThreads.end(); ++i ) {
+			i->join( );
+		}
+
+		// The workers' stages go into the gen.* phases, and their heap use
+		//  into this thread's, so the generate phase still open above them
+		//  covers it; their buffers are freed from this thread later
+		if( m_pProfile ) {
+			for( auto i = vProfiles.begin(); i != vProfiles.end(); ++i ) {
+				m_pProfile->merge( *i );
+			}
+			SAllocCounters xWorkers = { 0, 0, 0, 0 };
+			for( unsigned int i = 1; i < iThreads; ++i ) {
+				xWorkers.iCount += vAllocs[i].iCount;
+				xWorkers.iBytes += vAllocs[i].iBytes;
+				xWorkers.iLive += vAllocs[i].iLive;
+				xWorkers.iPeak += vAllocs[i].iPeak;
+			}
+			SAllocCounters::local().absorb( xWorkers );
+		}
+
+		std::exception_ptr pError;
+		for( auto i = vMessages.begin(); i != vMessages.end() && !pError; ++i ) {
+			pError = i->pError;
+		}
+
+		if( !pError ) {
+			m_pSplice = &vMessages;
+			m_pWorkers = &vWorkers;
+			m_iSpliceNext = 0;
+			try {
+				_gen( AST_ROOT, eStage_MAIN );
+			} catch( ... ) {
+				pError = std::current_exception( );
+			}
+			m_pSplice = nullptr;
+			m_pWorkers = nullptr;
+			m_unCommand = vMessages.empty() ? m_unCommand : vMessages.back().unType + 1;
+		}
+
+		for( auto i = vWorkers.begin(); i != vWorkers.end(); ++i ) {
+			delete *i;
+		}
+		if( pError ) {
+			std::rethrow_exception( pError );
+		}
+	}
+
+	// Messages are generated on up to iThreads threads; 0 means one per
+	//  core. The output is identical for any thread count.
+	void set_threads( unsigned int iThreads )
+	{
+		if( iThreads == 0 ) {
+			iThreads = std::thread::hardware_concurrency( );
+		}
+		m_iThreads = iThreads ? iThreads : 1;
+	}
+
+	// Instead of one file, write <pcBase>.h with everything declared
+	//  outside a namespace, and for every top-level namespace a header
+	//  <pcBase>.<ns>.h holding its types with serialize() and unserialize()
+	//  only declared, plus <pcBase>.<ns>.cpp defining them. pcBase is the
+	//  output's file name without extension, as the generated #includes
+	//  name it. nullptr turns splitting off. Each .cpp first includes
+	//  pcInclude, the ::net::encoding runtime, so it compiles on its own.
+	//  Split output is always generated on one thread.
+	void set_split( const char *pcBase, const char *pcInclude = "NetEncoding.h" )
+	{
+		m_bSplit = pcBase != nullptr;
+		m_sSplitBase = pcBase ? pcBase : "";
+		m_sSplitInclude = pcInclude;
+	}
+
+	// Also generate a view_X beside every pak_X; see _genView()
+	void set_views( bool bViews )
+	{
+		m_bViews = bViews;
 	}
 
 	bool generate( )
 	{
-		_gen( m_pRoot, eStage_MAIN );
+		IdlProfile::Scope xScope( m_pProfile, ePhase_Generate );
+		m_xOut.clear( );
+		_clearFiles( );
+		_markReached( );
+
+		if( m_bSplit ) {
+			m_xOut.text( "#pragma once\n\n" );
+			_gen( AST_ROOT, eStage_MAIN );
+			_finishSplit( );
+			return true;
+		}
+
+		// Below a few messages per thread, starting the pool costs more
+		//  than it saves
+		const size_t MIN_MESSAGES_PER_THREAD = 16;
+		std::vector<SGenMessage> vMessages;
+		if( m_iThreads > 1 ) {
+			_collectMessages( AST_ROOT, 0, vMessages );
+		}
+		size_t iThreads = vMessages.size() / MIN_MESSAGES_PER_THREAD;
+		if( iThreads > m_iThreads ) {
+			iThreads = m_iThreads;
+		}
+
+		if( iThreads > 1 ) {
+			_generateParallel( vMessages, (unsigned int)iThreads );
+		} else {
+			_gen( AST_ROOT, eStage_MAIN );
+		}
 
 		return true;
 	}
 
+	// The text produced by the last generate(); with splitting, <base>.h
+	const IdlOutput& get_output( ) const
+	{
+		return m_xOut;
+	}
+
+	// The other files of split output, named by what follows <base>
+	size_t extra_file_cnt( ) const { return m_vFiles.size(); }
+	const char* extra_file_suffix( size_t iIdx ) const { return m_vFiles[iIdx].sSuffix.c_str(); }
+	const IdlOutput& extra_file( size_t iIdx ) const { return *m_vFiles[iIdx].pText; }
+
+	bool write( const char *pcPath ) const
+	{
+		return m_xOut.write_file( pcPath );
+	}
+
 };
\ No newline at end of file
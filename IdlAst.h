@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <string.h>
+#include "IdlSymbols.h"
+
+enum eParseType
+{
+	ePT_Unknown = 0,
+	ePT_Root,
+	ePT_Typedef,
+	ePT_Enum,
+	ePT_Namespace,
+	ePT_Message,
+	ePT_Base,
+	ePT_List,
+	ePT_Var
+};
+
+static char* ePT_Names[] = {
+	"UNKNOWN",
+	"ROOT",
+	"TYPEDEF",
+	"ENUM",
+	"NAMESPACE",
+	"MESSAGE",
+	"BASE",
+	"LIST",
+	"VAR"
+};
+
+typedef unsigned int AstIdx;
+
+static const AstIdx AST_NONE = 0xFFFFFFFF;
+static const AstIdx AST_ROOT = 0;
+
+// One fixed-size record per AST node. Children live in a contiguous run of
+//  IdlAst::m_vChildren, and the node's symbol references in a run of
+//  IdlAst::m_vRefs:
+//    Message/Base/List - inherited base names
+//    Enum              - enum values
+//    Typedef           - [type]
+//    Var               - [type] or [type, array length]
+// IdlAst::m_vRefTargets runs parallel to m_vRefs and holds the node each
+//  inherited base name resolved to, filled in by IdlResolver.
+struct SAstNode
+{
+	unsigned char iType;
+	unsigned int iSrcOffset;
+	AstIdx iParent;
+	SymId iName;
+	unsigned int iChildBegin;
+	unsigned int iChildCnt;
+	unsigned int iRefBegin;
+	unsigned int iRefCnt;
+};
+
+template< typename T >
+struct SAstRange
+{
+	const T *pBegin;
+	const T *pEnd;
+
+	const T* begin( ) const { return pBegin; }
+	const T* end( ) const { return pEnd; }
+	size_t size( ) const { return pEnd - pBegin; }
+	bool empty( ) const { return pBegin == pEnd; }
+	const T& operator[]( size_t iIdx ) const { return pBegin[iIdx]; }
+};
+
+// Flat, arena-backed parse tree. Nodes are addressed by index, names by
+//  their IdlSymbols id, and the whole tree is released at once when the
+//  IdlAst goes away.
+class IdlAst
+{
+	friend class IdlSnapshot;
+
+protected:
+	const IdlSymbols *m_pSymbols;
+	std::vector<SAstNode> m_vNodes;
+	std::vector<AstIdx> m_vChildren;
+	std::vector<SymId> m_vRefs;
+	std::vector<AstIdx> m_vRefTargets;
+
+	template< typename T >
+	static SAstRange<T> _range( const std::vector<T>& vItems, unsigned int iBegin, unsigned int iCnt )
+	{
+		SAstRange<T> xRange;
+		xRange.pBegin = iCnt ? &vItems[iBegin] : nullptr;
+		xRange.pEnd = xRange.pBegin + iCnt;
+		return xRange;
+	}
+
+public:
+	IdlAst( const IdlSymbols *pSymbols )
+		: m_pSymbols(pSymbols)
+	{
+	}
+
+	void clear( )
+	{
+		m_vNodes.clear( );
+		m_vChildren.clear( );
+		m_vRefs.clear( );
+		m_vRefTargets.clear( );
+	}
+
+	// +++ Building
+	AstIdx add_node( eParseType iType, AstIdx iParent, unsigned int iSrcOffset, SymId iName = SYM_EMPTY )
+	{
+		SAstNode xNode;
+		xNode.iType = (unsigned char)iType;
+		xNode.iSrcOffset = iSrcOffset;
+		xNode.iParent = iParent;
+		xNode.iName = iName;
+		xNode.iChildBegin = 0;
+		xNode.iChildCnt = 0;
+		xNode.iRefBegin = 0;
+		xNode.iRefCnt = 0;
+		m_vNodes.push_back( xNode );
+		return (AstIdx)( m_vNodes.size() - 1 );
+	}
+
+	// A node's refs must be added back-to-back, before any other node
+	//  adds refs of its own.
+	void add_ref( AstIdx iNode, SymId iSym )
+	{
+		SAstNode& xNode = m_vNodes[iNode];
+		if( xNode.iRefCnt == 0 ) {
+			xNode.iRefBegin = (unsigned int)m_vRefs.size( );
+		}
+		m_vRefs.push_back( iSym );
+		m_vRefTargets.push_back( AST_NONE );
+		xNode.iRefCnt++;
+	}
+
+	void set_ref_target( AstIdx iNode, size_t iIdx, AstIdx iTarget )
+	{
+		m_vRefTargets[m_vNodes[iNode].iRefBegin + iIdx] = iTarget;
+	}
+
+	void set_children( AstIdx iNode, const AstIdx *piChildren, size_t iCount )
+	{
+		SAstNode& xNode = m_vNodes[iNode];
+		xNode.iChildBegin = (unsigned int)m_vChildren.size( );
+		xNode.iChildCnt = (unsigned int)iCount;
+		m_vChildren.insert( m_vChildren.end(), piChildren, piChildren + iCount );
+	}
+	// --- Building
+
+	size_t node_cnt( ) const { return m_vNodes.size(); }
+	const SAstNode& node( AstIdx iNode ) const { return m_vNodes[iNode]; }
+
+	eParseType type( AstIdx iNode ) const { return (eParseType)m_vNodes[iNode].iType; }
+	AstIdx parent( AstIdx iNode ) const { return m_vNodes[iNode].iParent; }
+	unsigned int src_offset( AstIdx iNode ) const { return m_vNodes[iNode].iSrcOffset; }
+
+	const IdlSymbols* symbols( ) const { return m_pSymbols; }
+	const char* str( SymId iSym ) const { return m_pSymbols->str( iSym ); }
+	SymId name_id( AstIdx iNode ) const { return m_vNodes[iNode].iName; }
+	const char* name( AstIdx iNode ) const { return str( m_vNodes[iNode].iName ); }
+
+	SAstRange<AstIdx> children( AstIdx iNode ) const
+	{
+		return _range( m_vChildren, m_vNodes[iNode].iChildBegin, m_vNodes[iNode].iChildCnt );
+	}
+
+	SAstRange<SymId> refs( AstIdx iNode ) const
+	{
+		return _range( m_vRefs, m_vNodes[iNode].iRefBegin, m_vNodes[iNode].iRefCnt );
+	}
+
+	// Message/Base/List; AST_NONE until the node has been resolved
+	SAstRange<AstIdx> ref_targets( AstIdx iNode ) const
+	{
+		return _range( m_vRefTargets, m_vNodes[iNode].iRefBegin, m_vNodes[iNode].iRefCnt );
+	}
+
+	// Var and Typedef
+	const char* var_type( AstIdx iNode ) const
+	{
+		return str( m_vRefs[m_vNodes[iNode].iRefBegin] );
+	}
+
+	// Var only; "" when the var is not an array
+	const char* arrlen( AstIdx iNode ) const
+	{
+		const SAstNode& xNode = m_vNodes[iNode];
+		return xNode.iRefCnt > 1 ? str( m_vRefs[xNode.iRefBegin + 1] ) : str( SYM_EMPTY );
+	}
+
+	// Var only; SYM_EMPTY when the var is not an array
+	SymId arrlen_id( AstIdx iNode ) const
+	{
+		const SAstNode& xNode = m_vNodes[iNode];
+		return xNode.iRefCnt > 1 ? m_vRefs[xNode.iRefBegin + 1] : SYM_EMPTY;
+	}
+
+	SymId var_type_id( AstIdx iNode ) const
+	{
+		return m_vRefs[m_vNodes[iNode].iRefBegin];
+	}
+
+	bool is_array( AstIdx iNode ) const
+	{
+		return arrlen_id( iNode ) != SYM_EMPTY;
+	}
+
+	// Bytes held by the arena, including unused vector capacity. Names
+	//  are owned by the shared IdlSymbols and are not counted here.
+	size_t memory_usage( ) const
+	{
+		return m_vNodes.capacity() * sizeof(SAstNode) +
+			m_vChildren.capacity() * sizeof(AstIdx) +
+			m_vRefs.capacity() * sizeof(SymId) +
+			m_vRefTargets.capacity() * sizeof(AstIdx);
+	}
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <atomic>
+#include "IdlInput.h"
+#include "IdlOutput.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Bumped whenever generated output changes for the same input, so stale
+//  cache entries are never reused. The build stamp covers local changes
+//  made between version bumps.
+#define IDL_COMPILER_VERSION "netcompile-2.1 " __DATE__ " " __TIME__
+
+// On-disk cache of generated output, keyed by a 64-bit hash of the input
+//  bytes, the compiler version and the options that affect generation.
+//  Each entry is one file: a header line recording how long the original
+//  compile took, then the generated text.
+class IdlCache
+{
+protected:
+	std::string m_sDir;
+	unsigned long long m_uSalt;
+
+	static const unsigned long long FNV_BASIS = 14695981039346656037ull;
+	static const unsigned long long FNV_PRIME = 1099511628211ull;
+
+	static unsigned long long _hash( unsigned long long uHash, const char *pcData, size_t iLength )
+	{
+		for( size_t i = 0; i < iLength; ++i ) {
+			uHash = ( uHash ^ (unsigned char)pcData[i] ) * FNV_PRIME;
+		}
+		return uHash;
+	}
+
+	// Written to a temporary name first so a concurrent reader never sees
+	//  a partial entry. The name is unique to this process and this store,
+	//  as other processes may be writing the same entry into the same
+	//  directory.
+	static bool _storeFile( const std::string& sPath, const char *pcHeader, const IdlOutput& xOut )
+	{
+		static std::atomic<unsigned int> s_iTmpCnt( 0 );
+#ifdef _WIN32
+		unsigned int iPid = (unsigned int)_getpid( );
+#else
+		unsigned int iPid = (unsigned int)getpid( );
+#endif
+		char acTmp[32];
+		sprintf( acTmp, ".%u.%u.tmp", iPid, s_iTmpCnt++ );
+		std::string sTmpPath = sPath + acTmp;
+
+		FILE *fHandle = fopen( sTmpPath.c_str(), "wb" );
+		if( !fHandle ) {
+			return false;
+		}
+
+		bool bResult = fputs( pcHeader, fHandle ) >= 0 && xOut.write( fHandle );
+		if( fclose( fHandle ) != 0 ) {
+			bResult = false;
+		}
+
+		if( bResult ) {
+			remove( sPath.c_str() );
+			bResult = rename( sTmpPath.c_str(), sPath.c_str() ) == 0;
+		}
+		if( !bResult ) {
+			remove( sTmpPath.c_str() );
+		}
+		return bResult;
+	}
+
+public:
+	IdlCache( const char *pcDir, const std::string& sOptions )
+		: m_sDir(pcDir)
+	{
+		if( !m_sDir.empty() && m_sDir[m_sDir.size()-1] != '/' && m_sDir[m_sDir.size()-1] != '\\' ) {
+			m_sDir += '/';
+		}
+
+		IdlOutput::make_dir( pcDir );
+
+		const char *pcVersion = IDL_COMPILER_VERSION;
+		m_uSalt = _hash( FNV_BASIS, pcVersion, strlen(pcVersion) + 1 );
+		m_uSalt = _hash( m_uSalt, sOptions.data(), sOptions.size() + 1 );
+	}
+
+	std::string entry_path( unsigned long long uKey, const char *pcExt = ".idlc" ) const
+	{
+		char acName[32];
+		sprintf( acName, "%016llx", uKey );
+		return m_sDir + acName + pcExt;
+	}
+
+	unsigned long long key( const IdlInput& xInput ) const
+	{
+		return _hash( m_uSalt, xInput.begin(), xInput.size() );
+	}
+
+	// Maps the entry for uKey into xEntry. On success [pcText,pcText+iLength)
+	//  is the cached output and dCompileMs the time the original compile took.
+	bool load( unsigned long long uKey, IdlInput& xEntry, const char *&pcText, size_t& iLength, double& dCompileMs ) const
+	{
+		if( !xEntry.open( entry_path( uKey ).c_str() ) ) {
+			return false;
+		}
+
+		const char *pcHeaderEnd = IdlScan::find_newline( xEntry.begin(), xEntry.end() );
+		if( pcHeaderEnd == xEntry.end() || xEntry.size() < 5 || memcmp( xEntry.begin(), "IDLC ", 5 ) != 0 ) {
+			return false;
+		}
+
+		dCompileMs = atof( xEntry.begin() + 5 );
+		pcText = pcHeaderEnd + 1;
+		iLength = xEntry.end() - pcText;
+		return true;
+	}
+
+	bool store( unsigned long long uKey, const IdlOutput& xOut, double dCompileMs ) const
+	{
+		char acHeader[64];
+		sprintf( acHeader, "IDLC %.3f\n", dCompileMs );
+		return _storeFile( entry_path( uKey ), acHeader, xOut );
+	}
+
+	// Stores a raw entry, such as an AST snapshot, under its own extension
+	bool store_raw( unsigned long long uKey, const char *pcExt, const IdlOutput& xOut ) const
+	{
+		return _storeFile( entry_path( uKey, pcExt ), "", xOut );
+	}
+
+	// Leaves pcPath untouched, timestamp included, when it already holds
+	//  exactly this text. Returns false only if a needed write failed.
+	static bool write_if_changed( const char *pcPath, const char *pcText, size_t iLength, bool& bWritten )
+	{
+		bWritten = false;
+		{
+			IdlInput xExisting;
+			if( xExisting.open( pcPath ) && xExisting.size() == iLength && memcmp( xExisting.begin(), pcText, iLength ) == 0 ) {
+				return true;
+			}
+		}
+
+		FILE *fHandle = fopen( pcPath, "wb" );
+		if( !fHandle ) {
+			return false;
+		}
+
+		bool bResult = fwrite( pcText, 1, iLength, fHandle ) == iLength;
+		if( fclose( fHandle ) != 0 ) {
+			bResult = false;
+		}
+		bWritten = bResult;
+		return bResult;
+	}
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "IdlInput.h"
+#include "IdlLexer.h"
+#include "IdlParser.h"
+#include "IdlResolver.h"
+#include "CppGenerator.h"
+#include "IdlCache.h"
+#include "IdlSnapshot.h"
+#include "IdlProfile.h"
+
+// A file of split output other than the main header, named by the text
+//  that follows the output's base name (".game.h", ".game.cpp")
+struct SCompiledFile
+{
+	std::string sSuffix;
+	std::string sText;
+};
+
+// One compilation of one schema: lexing through generation, with the
+//  generated code and any diagnostics kept on the object. Nothing is
+//  shared between instances, so any number may run at once on different
+//  threads; this is the entry point for embedding the compiler.
+class IdlCompiler
+{
+protected:
+	const IdlCache *m_pSnapshots;
+	IdlProfile *m_pProfile;
+	unsigned int m_iGenThreads;
+	std::string m_sSplitBase;
+	std::string m_sSplitInclude;
+	bool m_bSplit;
+	bool m_bViews;
+	std::vector<std::string> m_vRoots;
+	IdlOutput m_xOut;
+	std::vector<SCompiledFile> m_vExtraFiles;
+	IdlOutput m_xDiag;
+	bool m_bFromSnapshot;
+
+	void _count( const IdlTokenList& xTokens, const IdlAst& xAst, const IdlLayouts& xLayouts )
+	{
+		m_pProfile->iTokens += xTokens.size( );
+		m_pProfile->iNodes += xAst.node_cnt( );
+		m_pProfile->iMessages += xLayouts.size( );
+		for( AstIdx i = 0; i < xAst.node_cnt(); ++i ) {
+			if( xAst.type(i) == ePT_Base ) {
+				m_pProfile->iBases++;
+			}
+		}
+		const char *pcEnd = m_xOut.data() + m_xOut.size( );
+		for( const char *p = m_xOut.data(); p != pcEnd; ++p ) {
+			if( *p == '\n' ) {
+				m_pProfile->iLines++;
+			}
+		}
+		for( auto i = m_vExtraFiles.begin(); i != m_vExtraFiles.end(); ++i ) {
+			for( auto p = i->sText.begin(); p != i->sText.end(); ++p ) {
+				if( *p == '\n' ) {
+					m_pProfile->iLines++;
+				}
+			}
+		}
+	}
+
+public:
+	// With pSnapshots, validated ASTs are reloaded from and saved to it
+	IdlCompiler( const IdlCache *pSnapshots = nullptr )
+		: m_pSnapshots(pSnapshots), m_pProfile(nullptr), m_iGenThreads(1), m_bSplit(false), m_bViews(false), m_bFromSnapshot(false)
+	{
+	}
+
+	// Threads CppGenerator may use for this schema's messages; 0 is one
+	//  per core
+	void set_gen_threads( unsigned int iThreads )
+	{
+		m_iGenThreads = iThreads;
+	}
+
+	// See CppGenerator::set_split(); the extra files are in extra_files()
+	void set_split( const char *pcBase, const char *pcInclude = "NetEncoding.h" )
+	{
+		m_bSplit = pcBase != nullptr;
+		m_sSplitBase = pcBase ? pcBase : "";
+		m_sSplitInclude = pcInclude;
+	}
+
+	// See CppGenerator::set_views()
+	void set_views( bool bViews )
+	{
+		m_bViews = bViews;
+	}
+
+	// See CppGenerator::set_roots()
+	void set_roots( const std::vector<std::string>& vRoots )
+	{
+		m_vRoots = vRoots;
+	}
+
+	// Each compile() adds its phase timings and counts to pProfile;
+	//  nullptr turns them off
+	void set_profile( IdlProfile *pProfile )
+	{
+		m_pProfile = pProfile;
+	}
+
+	// pcName is only used to label diagnostics
+	bool compile( const IdlInput& xInput, const char *pcName )
+	{
+		m_xOut.clear( );
+		m_vExtraFiles.clear( );
+		m_xDiag.clear( );
+		m_bFromSnapshot = false;
+
+		// Declared ahead of the symbols, which may point into its text
+		IdlInput xImage;
+		IdlSymbols xSymbols;
+		IdlLexer xLexer( &xInput, &xSymbols );
+		IdlTokenList xTokens;
+		IdlParser xParser( &xTokens, &xSymbols );
+		IdlAst& xAst = xParser.get_ast( );
+
+		unsigned long long uImageKey = 0;
+		if( m_pSnapshots ) {
+			IdlProfile::Scope xScope( m_pProfile, ePhase_Snapshot );
+			uImageKey = m_pSnapshots->key( xInput );
+			if( xImage.open( m_pSnapshots->entry_path( uImageKey, ".idls" ).c_str() ) ) {
+				m_bFromSnapshot = IdlSnapshot::load( xImage, uImageKey, xSymbols, xAst );
+			}
+		}
+
+		try {
+			IdlLayouts xLayouts;
+			if( m_bFromSnapshot ) {
+				IdlProfile::Scope xScope( m_pProfile, ePhase_Snapshot );
+				xLayouts.build( &xAst );
+			} else {
+				{
+					IdlProfile::Scope xScope( m_pProfile, ePhase_Lex );
+					xLexer.tokenize( xTokens );
+				}
+				{
+					IdlProfile::Scope xScope( m_pProfile, ePhase_Parse );
+					xParser.parse( );
+				}
+				{
+					IdlProfile::Scope xScope( m_pProfile, ePhase_Resolve );
+					IdlResolver xResolver( &xAst );
+					xResolver.validate( );
+					xResolver.take_layouts( xLayouts );
+				}
+
+				if( m_pSnapshots ) {
+					IdlProfile::Scope xScope( m_pProfile, ePhase_Snapshot );
+					IdlOutput xImageOut;
+					IdlSnapshot::write( xImageOut, xAst, uImageKey );
+					m_pSnapshots->store_raw( uImageKey, ".idls", xImageOut );
+				}
+			}
+
+			CppGenerator xGen( &xAst, &xLayouts );
+			xGen.set_profile( m_pProfile );
+			xGen.set_threads( m_iGenThreads );
+			xGen.set_split( m_bSplit ? m_sSplitBase.c_str() : nullptr, m_sSplitInclude.c_str() );
+			xGen.set_views( m_bViews );
+			xGen.set_roots( m_vRoots );
+			xGen.generate( );
+			const IdlOutput& xGenOut = xGen.get_output( );
+			m_xOut.append( xGenOut.data(), xGenOut.size() );
+			for( size_t i = 0; i < xGen.extra_file_cnt(); ++i ) {
+				SCompiledFile xFile;
+				xFile.sSuffix = xGen.extra_file_suffix( i );
+				xFile.sText = xGen.extra_file( i ).str( );
+				m_vExtraFiles.push_back( xFile );
+			}
+
+			if( m_pProfile ) {
+				_count( xTokens, xAst, xLayouts );
+			}
+			return true;
+
+		} catch( LexException e ) {
+			m_xDiag.line( "%s(%d): lexer error: %s\n", pcName, e.line_num(), e.what() );
+		} catch( ParseTokException e ) {
+			m_xDiag.line( "%s(%d): parser error: %s -> '%s'\n", pcName, xInput.line_num(e.token().iOffset), e.what(), std::string(e.token().sText).c_str() );
+		} catch( ResolveException e ) {
+			m_xDiag.line( "%s(%d): validate error: %s\n", pcName, xInput.line_num(xAst.src_offset(e.node())), e.what() );
+		} catch( GenException e ) {
+			m_xDiag.line( "%s(%d): validate error: %s\n", pcName, xInput.line_num(xAst.src_offset(e.node())), e.what() );
+		}
+		return false;
+	}
+
+	// Compiles a schema held in memory; the buffer is not copied
+	bool compile_buffer( const char *pcName, const char *pcData, size_t iLength )
+	{
+		IdlInput xInput;
+		xInput.assign( pcData, iLength );
+		return compile( xInput, pcName );
+	}
+
+	const IdlOutput& output( ) const { return m_xOut; }
+	const std::vector<SCompiledFile>& extra_files( ) const { return m_vExtraFiles; }
+	std::string diagnostics( ) const { return m_xDiag.str(); }
+	bool from_snapshot( ) const { return m_bFromSnapshot; }
+
+private:
+	IdlCompiler( const IdlCompiler& );
+	IdlCompiler& operator=( const IdlCompiler& );
+};
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "IdlCompiler.h"
+
+// One input file and everything produced for it. Diagnostics are kept on
+//  the job rather than printed, so a parallel run can report them in the
+//  order the files were given.
+struct SCompileJob
+{
+	std::string sInput;
+	std::string sOutput;
+	bool bSuccess;
+	bool bCacheHit;
+	bool bFromSnapshot;
+	bool bWritten;
+	double dCompileMs;		// time the pipeline took, or would have taken on a hit
+	double dElapsedMs;		// time actually spent on the job
+	std::string sDiagnostics;
+	IdlProfile xProfile;	// filled in only when the driver is profiling
+};
+
+// Runs the full v2 pipeline over a set of files. Every file gets its own
+//  input and IdlCompiler, so files share nothing and are compiled on as
+//  many threads as requested.
+class IdlDriver
+{
+protected:
+	std::vector<SCompileJob> m_vJobs;
+	IdlCache *m_pCache;
+	IdlCache *m_pSnapshots;
+	bool m_bProfile;
+	bool m_bSplit;
+	std::string m_sSplitInclude;
+	bool m_bViews;
+	std::vector<std::string> m_vRoots;
+	unsigned int m_iGenThreads;
+
+	static double _msSince( std::chrono::steady_clock::time_point xStart )
+	{
+		return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
+	}
+
+	static void _writeOutput( SCompileJob& xJob, const char *pcText, size_t iLength, IdlOutput& xDiag )
+	{
+		if( IdlCache::write_if_changed( xJob.sOutput.c_str(), pcText, iLength, xJob.bWritten ) ) {
+			xJob.bSuccess = true;
+		} else {
+			xDiag.line( "%s: failed to write output file\n", xJob.sOutput.c_str() );
+		}
+	}
+
+	static std::string _stripExtension( const std::string& sPath )
+	{
+		size_t iSlash = sPath.find_last_of( "/\\" );
+		size_t iDot = sPath.find_last_of( '.' );
+		if( iDot != std::string::npos && ( iSlash == std::string::npos || iDot > iSlash ) ) {
+			return sPath.substr( 0, iDot );
+		}
+		return sPath;
+	}
+
+public:
+	IdlDriver( )
+		: m_pCache(nullptr), m_pSnapshots(nullptr), m_bProfile(false), m_bSplit(false), m_sSplitInclude("NetEncoding.h"), m_bViews(false), m_iGenThreads(1)
+	{
+	}
+
+	~IdlDriver( )
+	{
+		delete m_pCache;
+		delete m_pSnapshots;
+	}
+
+	// sOptions must name every option that changes generated output
+	void set_cache( const char *pcDir, const std::string& sOptions )
+	{
+		delete m_pCache;
+		m_pCache = new IdlCache( pcDir, sOptions );
+	}
+
+	// Validated ASTs are kept in pcDir and reloaded in place of lexing,
+	//  parsing and resolving an unchanged input.
+	void set_snapshots( const char *pcDir )
+	{
+		delete m_pSnapshots;
+		m_pSnapshots = new IdlCache( pcDir, "ast" );
+	}
+
+	// Each output <name>.h is split into per-namespace headers and
+	//  serializer sources beside it; see CppGenerator::set_split(). The
+	//  output cache is not used for split output. Each source includes
+	//  sInclude, the path its compiler finds the runtime under.
+	void set_split( bool bSplit, const std::string& sInclude = "NetEncoding.h" )
+	{
+		m_bSplit = bSplit;
+		m_sSplitInclude = sInclude;
+	}
+
+	// Read-only view_X classes are generated beside each pak_X; see
+	//  CppGenerator::set_views(). A cache must be given this among its
+	//  options.
+	void set_views( bool bViews )
+	{
+		m_bViews = bViews;
+	}
+
+	// Only these messages and namespaces are generated from each file;
+	//  see CppGenerator::set_roots(). A cache must be given the roots
+	//  among its options.
+	void set_roots( const std::vector<std::string>& vRoots )
+	{
+		m_vRoots = vRoots;
+	}
+
+	// Threads each file's messages are generated on; 0 is one per core
+	void set_gen_threads( unsigned int iThreads )
+	{
+		m_iGenThreads = iThreads;
+	}
+
+	// Records per-phase timings and heap use on each job's xProfile
+	void set_profile( bool bProfile )
+	{
+		m_bProfile = bProfile;
+	}
+
+	// Output goes to <input without extension>.h, or to <dir>/<name>.h
+	//  when pcOutDir is given. Standard input ("-") is named stdin.h.
+	static std::string output_path( const std::string& sInput, const char *pcOutDir )
+	{
+		std::string sBase = sInput == "-" ? "stdin" : _stripExtension( sInput );
+		if( !pcOutDir ) {
+			return sBase + ".h";
+		}
+
+		size_t iSlash = sBase.find_last_of( "/\\" );
+		std::string sName = iSlash == std::string::npos ? sBase : sBase.substr( iSlash + 1 );
+		std::string sDir = pcOutDir;
+		if( !sDir.empty() && sDir[sDir.size()-1] != '/' && sDir[sDir.size()-1] != '\\' ) {
+			sDir += '/';
+		}
+		return sDir + sName + ".h";
+	}
+
+	// Compiles one file. With a cache, an input whose entry exists skips
+	//  the pipeline entirely; with snapshots, only generation is repeated.
+	//  Either way the output file is only rewritten when its content changes.
+	bool compile( SCompileJob& xJob ) const
+	{
+		const IdlCache *pCache = m_bSplit ? nullptr : m_pCache;
+		auto xStart = std::chrono::steady_clock::now( );
+		const char *pcFilename = xJob.sInput.c_str( );
+		IdlOutput xDiag;
+		xJob.bSuccess = false;
+		xJob.bCacheHit = false;
+		xJob.bFromSnapshot = false;
+		xJob.bWritten = false;
+		xJob.dCompileMs = 0;
+		xJob.xProfile.clear( );
+
+		IdlInput xInput;
+		if( !xInput.open( pcFilename ) ) {
+			xDiag.line( "%s: failed to open input file\n", pcFilename );
+			xJob.sDiagnostics = xDiag.str( );
+			xJob.dElapsedMs = _msSince( xStart );
+			return false;
+		}
+
+		unsigned long long uKey = 0;
+		if( pCache ) {
+			uKey = pCache->key( xInput );
+
+			IdlInput xEntry;
+			const char *pcText;
+			size_t iLength;
+			if( pCache->load( uKey, xEntry, pcText, iLength, xJob.dCompileMs ) ) {
+				xJob.bCacheHit = true;
+				_writeOutput( xJob, pcText, iLength, xDiag );
+				xJob.sDiagnostics = xDiag.str( );
+				xJob.dElapsedMs = _msSince( xStart );
+				return xJob.bSuccess;
+			}
+		}
+
+		std::string sSplitPath = _stripExtension( xJob.sOutput );
+		size_t iSlash = sSplitPath.find_last_of( "/\\" );
+		std::string sSplitBase = iSlash == std::string::npos ? sSplitPath : sSplitPath.substr( iSlash + 1 );
+
+		IdlCompiler xCompiler( m_pSnapshots );
+		xCompiler.set_gen_threads( m_iGenThreads );
+		xCompiler.set_split( m_bSplit ? sSplitBase.c_str() : nullptr, m_sSplitInclude.c_str() );
+		xCompiler.set_views( m_bViews );
+		xCompiler.set_roots( m_vRoots );
+		if( m_bProfile ) {
+			xCompiler.set_profile( &xJob.xProfile );
+		}
+		bool bCompiled = xCompiler.compile( xInput, pcFilename );
+		xJob.bFromSnapshot = xCompiler.from_snapshot( );
+		xJob.dCompileMs = _msSince( xStart );
+		xDiag.text( "%s", xCompiler.diagnostics().c_str() );
+
+		if( bCompiled ) {
+			const IdlOutput& xOut = xCompiler.output( );
+			_writeOutput( xJob, xOut.data(), xOut.size(), xDiag );
+
+			auto& vExtra = xCompiler.extra_files( );
+			for( auto i = vExtra.begin(); i != vExtra.end() && xJob.bSuccess; ++i ) {
+				std::string sPath = sSplitPath + i->sSuffix;
+				bool bWritten;
+				if( !IdlCache::write_if_changed( sPath.c_str(), i->sText.data(), i->sText.size(), bWritten ) ) {
+					xDiag.line( "%s: failed to write output file\n", sPath.c_str() );
+					xJob.bSuccess = false;
+				}
+				xJob.bWritten = xJob.bWritten || bWritten;
+			}
+
+			// Failed compiles are never cached, so their diagnostics repeat
+			if( pCache && xJob.bSuccess ) {
+				pCache->store( uKey, xOut, xJob.dCompileMs );
+			}
+		}
+
+		xJob.sDiagnostics = xDiag.str( );
+		xJob.dElapsedMs = _msSince( xStart );
+		return xJob.bSuccess;
+	}
+
+	void add( const std::string& sInput, const std::string& sOutput )
+	{
+		SCompileJob xJob;
+		xJob.sInput = sInput;
+		xJob.sOutput = sOutput;
+		xJob.bSuccess = false;
+		xJob.bCacheHit = false;
+		xJob.bFromSnapshot = false;
+		xJob.bWritten = false;
+		xJob.dCompileMs = 0;
+		xJob.dElapsedMs = 0;
+		m_vJobs.push_back( xJob );
+	}
+
+	// Compiles every job, pulling from a shared counter so a slow file
+	//  does not hold up a whole batch. Returns the number that failed.
+	size_t run( unsigned int iThreads )
+	{
+		if( iThreads == 0 ) {
+			iThreads = std::thread::hardware_concurrency( );
+		}
+		if( iThreads == 0 ) {
+			iThreads = 1;
+		}
+		if( iThreads > m_vJobs.size() ) {
+			iThreads = (unsigned int)m_vJobs.size( );
+		}
+
+		std::atomic<size_t> iNext( 0 );
+		auto fnWorker = [this, &iNext]( ) {
+			for( size_t i = iNext++; i < m_vJobs.size(); i = iNext++ ) {
+				compile( m_vJobs[i] );
+			}
+		};
+
+		if( iThreads <= 1 ) {
+			fnWorker( );
+		} else {
+			std::vector<std::thread> vThreads;
+			for( unsigned int i = 0; i < iThreads; ++i ) {
+				vThreads.push_back( std::thread( fnWorker ) );
+			}
+			for( auto i = vThreads.begin(); i != vThreads.end(); ++i ) {
+				i->join( );
+			}
+		}
+
+		size_t iFailed = 0;
+		for( auto i = m_vJobs.begin(); i != m_vJobs.end(); ++i ) {
+			if( !i->bSuccess ) {
+				iFailed++;
+			}
+		}
+		return iFailed;
+	}
+
+	// Compiles one job again, as after its input has changed
+	bool recompile( size_t iJob )
+	{
+		return compile( m_vJobs[iJob] );
+	}
+
+	const std::vector<SCompileJob>& jobs( ) const { return m_vJobs; }
+
+	// One-line summary of cache use and output writes for the last run()
+	std::string summary( ) const
+	{
+		size_t iHits = 0, iMisses = 0, iSnapshots = 0, iWritten = 0, iUnchanged = 0;
+		double dSavedMs = 0;
+		for( auto i = m_vJobs.begin(); i != m_vJobs.end(); ++i ) {
+			if( i->bCacheHit ) {
+				iHits++;
+				dSavedMs += i->dCompileMs - i->dElapsedMs;
+			} else {
+				iMisses++;
+			}
+			if( i->bFromSnapshot ) {
+				iSnapshots++;
+			}
+			if( i->bSuccess && i->bWritten ) {
+				iWritten++;
+			} else if( i->bSuccess ) {
+				iUnchanged++;
+			}
+		}
+
+		std::string sLine;
+		char acPart[128];
+		if( m_pCache ) {
+			sprintf( acPart, "cache: %u hits, %u misses, %.1f ms saved; ", (unsigned)iHits, (unsigned)iMisses, dSavedMs );
+			sLine += acPart;
+		}
+		if( m_pSnapshots ) {
+			sprintf( acPart, "snapshots: %u loaded; ", (unsigned)iSnapshots );
+			sLine += acPart;
+		}
+		sprintf( acPart, "outputs: %u written, %u unchanged\n", (unsigned)iWritten, (unsigned)iUnchanged );
+		return sLine + acPart;
+	}
+
+private:
+	IdlDriver( const IdlDriver& );
+	IdlDriver& operator=( const IdlDriver& );
+};
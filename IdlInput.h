@@ -0,0 +1,214 @@
+#pragma once
+#pragma warning( disable: 4996 )
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "IdlScan.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Holds the entire contents of an input as one contiguous byte range.
+//  Regular files are memory-mapped, anything else (pipes, stdin) is
+//  pulled in with chunked reads, so the lexers can scan with a plain
+//  cursor and never need to seek.
+class IdlInput
+{
+protected:
+	const char *m_pcData;
+	size_t m_iSize;
+	std::vector<char> m_vBuffer;
+	mutable std::vector<size_t> m_vNewlines;
+	mutable bool m_bNewlinesBuilt;
+
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#else
+	void *m_pMapping;
+#endif
+
+	static const size_t READ_CHUNK = 64 * 1024;
+
+	bool _mapFile( const char *pcFilename )
+	{
+#ifdef _WIN32
+		m_hFile = CreateFileA( pcFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if( m_hFile == INVALID_HANDLE_VALUE ) {
+			return false;
+		}
+
+		LARGE_INTEGER xSize;
+		if( GetFileType( m_hFile ) != FILE_TYPE_DISK || !GetFileSizeEx( m_hFile, &xSize ) || xSize.QuadPart == 0 ) {
+			return false;
+		}
+
+		m_hMapping = CreateFileMappingA( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( !m_hMapping ) {
+			return false;
+		}
+
+		m_pcData = (const char*)MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+		if( !m_pcData ) {
+			return false;
+		}
+		m_iSize = (size_t)xSize.QuadPart;
+		return true;
+#else
+		int iFd = ::open( pcFilename, O_RDONLY );
+		if( iFd < 0 ) {
+			return false;
+		}
+
+		struct stat xStat;
+		if( fstat( iFd, &xStat ) != 0 || !S_ISREG(xStat.st_mode) || xStat.st_size == 0 ) {
+			::close( iFd );
+			return false;
+		}
+
+		void *pMapping = mmap( nullptr, (size_t)xStat.st_size, PROT_READ, MAP_PRIVATE, iFd, 0 );
+		::close( iFd );
+		if( pMapping == MAP_FAILED ) {
+			return false;
+		}
+
+		m_pMapping = pMapping;
+		m_pcData = (const char*)pMapping;
+		m_iSize = (size_t)xStat.st_size;
+		return true;
+#endif
+	}
+
+public:
+	IdlInput( )
+		: m_pcData(nullptr), m_iSize(0), m_bNewlinesBuilt(false)
+#ifdef _WIN32
+		, m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL)
+#else
+		, m_pMapping(nullptr)
+#endif
+	{
+	}
+
+	~IdlInput( )
+	{
+		close( );
+	}
+
+	// Maps a regular file, or falls back to buffered reads for anything
+	//  that cannot be mapped (FIFOs, character devices, empty files).
+	//  A filename of "-" reads stdin.
+	bool open( const char *pcFilename )
+	{
+		close( );
+
+		if( strcmp( pcFilename, "-" ) == 0 ) {
+			return read( stdin );
+		}
+
+		if( _mapFile( pcFilename ) ) {
+			return true;
+		}
+		close( );
+
+		FILE *fHandle = fopen( pcFilename, "rb" );
+		if( !fHandle ) {
+			return false;
+		}
+		bool bRetVal = read( fHandle );
+		fclose( fHandle );
+		return bRetVal;
+	}
+
+	// Reads a stream to completion in fixed-size chunks. Never seeks,
+	//  so it is safe for pipes and stdin.
+	bool read( FILE *fHandle )
+	{
+		close( );
+
+		while( true ) {
+			size_t iOldSize = m_vBuffer.size( );
+			m_vBuffer.resize( iOldSize + READ_CHUNK );
+			size_t iRead = fread( &m_vBuffer[iOldSize], 1, READ_CHUNK, fHandle );
+			m_vBuffer.resize( iOldSize + iRead );
+			if( iRead < READ_CHUNK ) {
+				break;
+			}
+		}
+
+		if( ferror( fHandle ) ) {
+			m_vBuffer.clear( );
+			return false;
+		}
+
+		m_pcData = m_vBuffer.empty() ? nullptr : &m_vBuffer[0];
+		m_iSize = m_vBuffer.size( );
+		return true;
+	}
+
+	// Scans a caller-owned buffer in place. Nothing is copied, so the
+	//  buffer must outlive this input and everything lexed from it.
+	void assign( const char *pcData, size_t iSize )
+	{
+		close( );
+		m_pcData = pcData;
+		m_iSize = iSize;
+	}
+
+	void close( )
+	{
+#ifdef _WIN32
+		if( m_hMapping ) {
+			if( m_pcData ) UnmapViewOfFile( m_pcData );
+			CloseHandle( m_hMapping );
+			m_hMapping = NULL;
+		}
+		if( m_hFile != INVALID_HANDLE_VALUE ) {
+			CloseHandle( m_hFile );
+			m_hFile = INVALID_HANDLE_VALUE;
+		}
+#else
+		if( m_pMapping ) {
+			munmap( m_pMapping, m_iSize );
+			m_pMapping = nullptr;
+		}
+#endif
+		m_vBuffer.clear( );
+		m_vNewlines.clear( );
+		m_bNewlinesBuilt = false;
+		m_pcData = nullptr;
+		m_iSize = 0;
+	}
+
+	// Maps a byte offset to its 1-based line number. Line numbers are only
+	//  needed for diagnostics, so the newline index is built on first use.
+	int line_num( size_t iOffset ) const
+	{
+		if( !m_bNewlinesBuilt ) {
+			for( const char *p = IdlScan::find_newline( begin(), end() ); p != end(); p = IdlScan::find_newline( p + 1, end() ) ) {
+				m_vNewlines.push_back( p - begin() );
+			}
+			m_bNewlinesBuilt = true;
+		}
+
+		return (int)( std::lower_bound( m_vNewlines.begin(), m_vNewlines.end(), iOffset ) - m_vNewlines.begin() ) + 1;
+	}
+
+	const char* begin( ) const { return m_pcData; }
+	const char* end( ) const { return m_pcData + m_iSize; }
+	size_t size( ) const { return m_iSize; }
+
+private:
+	IdlInput( const IdlInput& );
+	IdlInput& operator=( const IdlInput& );
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+struct SKeyword
+{
+	const char *pcText;
+	unsigned int iLength;
+	int iValue;
+};
+
+// Perfect hash over a fixed keyword set, generated at compile time. The
+//  constructor searches for a seed under which no two keywords share a
+//  slot, so a lookup costs one hash and at most one memcmp.
+template< size_t N, size_t TABLE_SIZE = 32 >
+class IdlKeywordTable
+{
+protected:
+	static_assert( (TABLE_SIZE & (TABLE_SIZE - 1)) == 0, "keyword table size must be a power of two" );
+	static_assert( N <= TABLE_SIZE / 2, "keyword table too small for keyword count" );
+
+	static const unsigned int MAX_SEED = 1 << 16;
+
+	SKeyword m_axKeywords[N];
+	signed char m_aiSlots[TABLE_SIZE];
+	unsigned int m_uSeed;
+
+	static constexpr unsigned int _hash( const char *pcText, size_t iLength, unsigned int uSeed )
+	{
+		unsigned int uHash = ( uSeed ^ (unsigned int)iLength ) * 0x9E3779B1u;
+		uHash = ( uHash ^ (unsigned char)pcText[0] ) * 0x85EBCA6Bu;
+		uHash = ( uHash ^ (unsigned char)pcText[iLength - 1] ) * 0xC2B2AE35u;
+		uHash = ( uHash ^ (unsigned char)pcText[iLength / 2] ) * 0x27D4EB2Fu;
+		return ( uHash >> 16 ) & ( TABLE_SIZE - 1 );
+	}
+
+	constexpr bool _trySeed( unsigned int uSeed )
+	{
+		for( size_t i = 0; i < TABLE_SIZE; ++i ) {
+			m_aiSlots[i] = -1;
+		}
+		for( size_t i = 0; i < N; ++i ) {
+			unsigned int uSlot = _hash( m_axKeywords[i].pcText, m_axKeywords[i].iLength, uSeed );
+			if( m_aiSlots[uSlot] >= 0 ) {
+				return false;
+			}
+			m_aiSlots[uSlot] = (signed char)i;
+		}
+		return true;
+	}
+
+public:
+	constexpr IdlKeywordTable( const SKeyword (&axKeywords)[N] )
+		: m_axKeywords(), m_aiSlots(), m_uSeed(0)
+	{
+		for( size_t i = 0; i < N; ++i ) {
+			m_axKeywords[i] = axKeywords[i];
+		}
+		while( !_trySeed( m_uSeed ) ) {
+			if( ++m_uSeed >= MAX_SEED ) {
+				throw "no perfect hash seed found for keyword set";
+			}
+		}
+	}
+
+	// Returns the keyword's iValue, or iDefault if the text is not a keyword.
+	int lookup( const char *pcText, size_t iLength, int iDefault ) const
+	{
+		if( iLength == 0 ) {
+			return iDefault;
+		}
+
+		int iSlot = m_aiSlots[_hash( pcText, iLength, m_uSeed )];
+		if( iSlot < 0 ) {
+			return iDefault;
+		}
+
+		const SKeyword& xKeyword = m_axKeywords[iSlot];
+		if( xKeyword.iLength != iLength || memcmp( xKeyword.pcText, pcText, iLength ) != 0 ) {
+			return iDefault;
+		}
+		return xKeyword.iValue;
+	}
+};
+
+template< size_t N >
+constexpr IdlKeywordTable<N> makeKeywordTable( const SKeyword (&axKeywords)[N] )
+{
+	return IdlKeywordTable<N>( axKeywords );
+}
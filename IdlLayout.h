@@ -0,0 +1,228 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <stdlib.h>
+#include "IdlAst.h"
+
+enum eLayoutKind
+{
+	eLK_Var = 0,
+	eLK_List,
+	eLK_ListEnd
+};
+
+// One entry of a message's flattened wire layout. A list is a List entry,
+//  the entries of its body, then a ListEnd entry; iListEnd on the List
+//  entry is the index of that ListEnd.
+struct SLayoutField
+{
+	unsigned char iKind;
+	unsigned char iDepth;
+	bool bFixed;
+	AstIdx iNode;
+	SymId iType;			// as written
+	SymId iWireType;		// after following typedefs
+	SymId iArrLen;			// SYM_EMPTY when not an array
+	unsigned int iArrCount;	// 0 unless the array length is a literal
+	unsigned int iWireSize;	// bytes on the wire when bFixed, else 0
+	unsigned int iListEnd;
+};
+
+struct SLayout
+{
+	AstIdx iMessage;
+	AstIdx iBadBase;		// node with an inherit that is not a Base, or AST_NONE
+	std::vector<SLayoutField> vFields;
+};
+
+// Per-message field layouts, emitted by IdlResolver once the tree has been
+//  validated. Inherited bases are inlined in declaration order, so each
+//  generator stage is a single pass over a message's field list.
+class IdlLayouts
+{
+protected:
+	const IdlAst *m_pAst;
+	std::vector<SLayout> m_vLayouts;
+	std::vector<unsigned int> m_viLayoutOf;
+	std::vector<unsigned int> m_viPrimSize;
+	std::vector<SymId> m_viTypedef;
+	size_t m_iTypedefCnt;
+
+	void _addPrim( const char *pcName, unsigned int iSize )
+	{
+		SymId iSym = m_pAst->symbols()->find( pcName );
+		if( iSym != SYM_NONE ) {
+			m_viPrimSize[iSym] = iSize;
+		}
+	}
+
+	// Typedefs are matched by name alone; the first declaration wins
+	SymId _wireType( SymId iType ) const
+	{
+		for( size_t i = 0; i < m_iTypedefCnt && m_viTypedef[iType] != SYM_NONE; ++i ) {
+			iType = m_viTypedef[iType];
+		}
+		return iType;
+	}
+
+	void _addVar( SLayout& xLayout, AstIdx iNode, unsigned int iDepth )
+	{
+		SLayoutField xField;
+		xField.iKind = eLK_Var;
+		xField.iDepth = (unsigned char)iDepth;
+		xField.iNode = iNode;
+		xField.iType = m_pAst->var_type_id( iNode );
+		xField.iWireType = _wireType( xField.iType );
+		xField.iArrLen = m_pAst->arrlen_id( iNode );
+		xField.iArrCount = 0;
+		xField.iListEnd = 0;
+
+		unsigned int iElemSize = m_viPrimSize[xField.iWireType];
+		if( xField.iArrLen != SYM_EMPTY ) {
+			const char *pcLen = m_pAst->str( xField.iArrLen );
+			char *pcEnd;
+			unsigned long iCount = strtoul( pcLen, &pcEnd, 0 );
+			if( *pcEnd == '\0' ) {
+				xField.iArrCount = (unsigned int)iCount;
+			}
+		}
+
+		if( xField.iArrLen == SYM_EMPTY ) {
+			xField.iWireSize = iElemSize;
+		} else {
+			xField.iWireSize = iElemSize * xField.iArrCount;
+		}
+		xField.bFixed = iElemSize != 0 && ( xField.iArrLen == SYM_EMPTY || xField.iArrCount != 0 );
+		if( !xField.bFixed ) {
+			xField.iWireSize = 0;
+		}
+
+		xLayout.vFields.push_back( xField );
+	}
+
+	void _addList( SLayout& xLayout, AstIdx iNode, unsigned int iDepth )
+	{
+		SLayoutField xField;
+		xField.iKind = eLK_List;
+		xField.iDepth = (unsigned char)iDepth;
+		xField.bFixed = false;
+		xField.iNode = iNode;
+		xField.iType = m_pAst->name_id( iNode );
+		xField.iWireType = xField.iType;
+		xField.iArrLen = SYM_EMPTY;
+		xField.iArrCount = 0;
+		xField.iWireSize = 0;
+		xField.iListEnd = 0;
+
+		size_t iBegin = xLayout.vFields.size( );
+		xLayout.vFields.push_back( xField );
+
+		// A list's own inherits are not inlined into its body
+		_addBody( xLayout, iNode, iDepth + 1 );
+
+		xField.iKind = eLK_ListEnd;
+		xLayout.vFields[iBegin].iListEnd = (unsigned int)xLayout.vFields.size( );
+		xLayout.vFields.push_back( xField );
+	}
+
+	void _addBody( SLayout& xLayout, AstIdx iNode, unsigned int iDepth )
+	{
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			if( m_pAst->type(*i) == ePT_Var ) {
+				_addVar( xLayout, *i, iDepth );
+			} else if( m_pAst->type(*i) == ePT_List ) {
+				_addList( xLayout, *i, iDepth );
+			}
+		}
+	}
+
+	void _addMsgCtx( SLayout& xLayout, AstIdx iNode )
+	{
+		auto xBases = m_pAst->ref_targets( iNode );
+		for( auto i = xBases.begin(); i != xBases.end(); ++i ) {
+			if( *i == AST_NONE || m_pAst->type(*i) != ePT_Base ) {
+				if( xLayout.iBadBase == AST_NONE ) {
+					xLayout.iBadBase = iNode;
+				}
+				continue;
+			}
+			_addMsgCtx( xLayout, *i );
+		}
+
+		_addBody( xLayout, iNode, 0 );
+	}
+
+public:
+	IdlLayouts( )
+		: m_pAst(nullptr), m_iTypedefCnt(0)
+	{
+	}
+
+	void build( const IdlAst *pAst )
+	{
+		m_pAst = pAst;
+		m_vLayouts.clear( );
+		m_viLayoutOf.assign( pAst->node_cnt(), 0xFFFFFFFF );
+
+		size_t iSymCnt = pAst->symbols()->size( );
+		m_viPrimSize.assign( iSymCnt, 0 );
+		_addPrim( "int8", 1 );
+		_addPrim( "uint8", 1 );
+		_addPrim( "int16", 2 );
+		_addPrim( "uint16", 2 );
+		_addPrim( "int32", 4 );
+		_addPrim( "uint32", 4 );
+		_addPrim( "int64", 8 );
+		_addPrim( "uint64", 8 );
+		_addPrim( "float", 4 );
+		_addPrim( "double", 8 );
+		_addPrim( "bool", 1 );
+		_addPrim( "char", 1 );
+
+		m_viTypedef.assign( iSymCnt, SYM_NONE );
+		m_iTypedefCnt = 0;
+		for( AstIdx i = 0; i < pAst->node_cnt(); ++i ) {
+			if( pAst->type(i) == ePT_Typedef && m_viTypedef[pAst->name_id(i)] == SYM_NONE ) {
+				m_viTypedef[pAst->name_id(i)] = pAst->var_type_id( i );
+				m_iTypedefCnt++;
+			}
+		}
+
+		for( AstIdx i = 0; i < pAst->node_cnt(); ++i ) {
+			if( pAst->type(i) != ePT_Message ) {
+				continue;
+			}
+
+			m_viLayoutOf[i] = (unsigned int)m_vLayouts.size( );
+			m_vLayouts.push_back( SLayout() );
+			SLayout& xLayout = m_vLayouts.back( );
+			xLayout.iMessage = i;
+			xLayout.iBadBase = AST_NONE;
+			_addMsgCtx( xLayout, i );
+		}
+	}
+
+	void swap( IdlLayouts& xOther )
+	{
+		std::swap( m_pAst, xOther.m_pAst );
+		m_vLayouts.swap( xOther.m_vLayouts );
+		m_viLayoutOf.swap( xOther.m_viLayoutOf );
+		m_viPrimSize.swap( xOther.m_viPrimSize );
+		m_viTypedef.swap( xOther.m_viTypedef );
+		std::swap( m_iTypedefCnt, xOther.m_iTypedefCnt );
+	}
+
+	size_t size( ) const { return m_vLayouts.size(); }
+	const SLayout& operator[]( size_t iIdx ) const { return m_vLayouts[iIdx]; }
+
+	// Returns nullptr when iMessage is not a message
+	const SLayout* find( AstIdx iMessage ) const
+	{
+		if( iMessage >= m_viLayoutOf.size() || m_viLayoutOf[iMessage] == 0xFFFFFFFF ) {
+			return nullptr;
+		}
+		return &m_vLayouts[m_viLayoutOf[iMessage]];
+	}
+};
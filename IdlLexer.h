@@ -3,8 +3,13 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <exception>
+#include "IdlInput.h"
+#include "IdlScan.h"
+#include "IdlKeywords.h"
+#include "IdlSymbols.h"
 
 class LexException : public std::exception
 {
@@ -20,65 +25,150 @@ public:
 	int line_num( ) const { return m_iLineNum; }
 };
 
+// Every token type, in enum order. Keywords also list their source text,
+//  which feeds the keyword hash below; adding a keyword only means adding
+//  a TOK_KEYWORD line here.
+#define IDL_TOKENS( TOK, TOK_KEYWORD ) \
+	TOK( UNKNOWN ) \
+	TOK( LITERAL ) \
+	TOK( COMMA ) \
+	TOK( BRACE_OPEN ) \
+	TOK( BRACE_CLOSE ) \
+	TOK( ARR_OPEN ) \
+	TOK( ARR_CLOSE ) \
+	TOK( SEPERATOR ) \
+	TOK( TERMINATOR ) \
+	TOK( COMMENT ) \
+	TOK( EOF ) \
+	TOK_KEYWORD( MESSAGE, "message" ) \
+	TOK_KEYWORD( BASE, "base" ) \
+	TOK_KEYWORD( ENUM, "enum" ) \
+	TOK_KEYWORD( TYPEDEF, "@type" ) \
+	TOK_KEYWORD( NAMESPACE, "namespace" ) \
+	TOK_KEYWORD( LIST, "list" )
+
+#define IDL_TOK_ENUM(x) eTok_##x,
+#define IDL_TOK_KEYWORD_ENUM(x,s) eTok_KEY_##x,
 enum eTok
 {
-	eTok_UNKNOWN = 0,
-	eTok_LITERAL,
-	eTok_COMMA,
-	eTok_BRACE_OPEN,
-	eTok_BRACE_CLOSE,
-	eTok_ARR_OPEN,
-	eTok_ARR_CLOSE,
-	eTok_SEPERATOR,
-	eTok_TERMINATOR,
-	eTok_COMMENT,
-	eTok_EOF,
-	eTok_KEY_MESSAGE,
-	eTok_KEY_BASE,
-	eTok_KEY_ENUM,
-	eTok_KEY_TYPEDEF,
-	eTok_KEY_NAMESPACE,
-	eTok_KEY_LIST
+	IDL_TOKENS( IDL_TOK_ENUM, IDL_TOK_KEYWORD_ENUM )
 };
+#undef IDL_TOK_ENUM
+#undef IDL_TOK_KEYWORD_ENUM
 
+#define IDL_TOK_NAME(x) #x,
+#define IDL_TOK_KEYWORD_NAME(x,s) "KEY_" #x,
 static char* eTok_Names[] = { 
-	"UNKNOWN",
-	"LITERAL", 
-	"COMMA", 
-	"BRACE_OPEN", 
-	"BRACE_CLOSE",
-	"ARR_OPEN",
-	"ARR_CLOSE",
-	"SEPERATOR",
-	"TERMINATOR", 
-	"COMMENT",
-	"EOF",
-	"KEY_MESSAGE",
-	"KEY_BASE",
-	"KEY_ENUM",
-	"KEY_TYPEDEF",
-	"KEY_NAMESPACE",
-	"KEY_LIST"
+	IDL_TOKENS( IDL_TOK_NAME, IDL_TOK_KEYWORD_NAME )
 };
+#undef IDL_TOK_NAME
+#undef IDL_TOK_KEYWORD_NAME
 
+#define IDL_TOK_NONE(x)
+#define IDL_TOK_KEYWORD(x,s) { s, sizeof(s) - 1, eTok_KEY_##x },
+static constexpr SKeyword eTok_Keywords[] = {
+	IDL_TOKENS( IDL_TOK_NONE, IDL_TOK_KEYWORD )
+};
+#undef IDL_TOK_NONE
+#undef IDL_TOK_KEYWORD
+
+static constexpr auto eTok_KeywordTable = makeKeywordTable( eTok_Keywords );
+
+// Token text is a view into the lexer's IdlInput, which must outlive
+//  every token (and every exception carrying one) read from it. Tokens
+//  carry their byte offset only; see IdlInput::line_num(). Literals are
+//  interned as they are lexed and carry their symbol in iSymbol.
 struct SToken
 {
-	int iLineNum;
+	unsigned int iOffset;
 	eTok iType;
 	int iValue;
-	std::string sText;
+	SymId iSymbol;
+	std::string_view sText;
+
+	SToken( ) : iOffset(0), iType(eTok_UNKNOWN), iValue(0), iSymbol(SYM_EMPTY) { }
+};
+
+// Whole-file token stream stored as parallel arrays, with the text of
+//  each token kept as an offset/length into the input buffer.
+class IdlTokenList
+{
+protected:
+	const char *m_pcBase;
+	std::vector<unsigned char> m_vTypes;
+	std::vector<unsigned int> m_vOffsets;
+	std::vector<unsigned int> m_vLengths;
+	std::vector<SymId> m_vSymbols;
+
+public:
+	IdlTokenList( ) : m_pcBase(nullptr) { }
+
+	void reset( const char *pcBase )
+	{
+		m_pcBase = pcBase;
+		m_vTypes.clear( );
+		m_vOffsets.clear( );
+		m_vLengths.clear( );
+		m_vSymbols.clear( );
+	}
+
+	void reserve( size_t iCount )
+	{
+		m_vTypes.reserve( iCount );
+		m_vOffsets.reserve( iCount );
+		m_vLengths.reserve( iCount );
+		m_vSymbols.reserve( iCount );
+	}
+
+	void add( eTok iType, unsigned int iOffset, unsigned int iLength, SymId iSymbol = SYM_EMPTY )
+	{
+		m_vTypes.push_back( (unsigned char)iType );
+		m_vOffsets.push_back( iOffset );
+		m_vLengths.push_back( iLength );
+		m_vSymbols.push_back( iSymbol );
+	}
+
+	void add( const SToken& xToken )
+	{
+		add( xToken.iType, xToken.iOffset, (unsigned int)xToken.sText.size(), xToken.iSymbol );
+	}
+
+
+	size_t size( ) const { return m_vTypes.size(); }
+	eTok type( size_t iIdx ) const { return (eTok)m_vTypes[iIdx]; }
+	unsigned int offset( size_t iIdx ) const { return m_vOffsets[iIdx]; }
+	SymId symbol( size_t iIdx ) const { return m_vSymbols[iIdx]; }
+	std::string_view text( size_t iIdx ) const { return std::string_view( m_pcBase + m_vOffsets[iIdx], m_vLengths[iIdx] ); }
+
+	SToken get( size_t iIdx ) const
+	{
+		SToken xToken;
+		xToken.iOffset = m_vOffsets[iIdx];
+		xToken.iType = (eTok)m_vTypes[iIdx];
+		xToken.iSymbol = m_vSymbols[iIdx];
+		xToken.sText = text( iIdx );
+		return xToken;
+	}
 };
 
 class IdlLexer
 {
 protected:
 	std::vector<SToken> m_asPeeks;
-	FILE *m_fHandle;
-	int m_iLineNum;
+	const IdlInput *m_pInput;
+	IdlSymbols *m_pSymbols;
+	const char *m_pcBegin;
+	const char *m_pcCur;
+	const char *m_pcEnd;
 
 	bool isEof( )
 	{
-		return feof( m_fHandle ) != 0;
+		return m_pcCur >= m_pcEnd;
+	}
+
+	int lineAt( const char *pcPos ) const
+	{
+		return m_pInput->line_num( pcPos - m_pcBegin );
 	}
 
 	static bool isEndOfLine( char cValue ) {
@@ -86,11 +176,11 @@ protected:
 	}
 
 	static bool isWhitespace( char cValue ) {
-		return cValue == '\r' || cValue == '\n' || cValue == '\t' || cValue == ' ';
+		return IdlScan::classify( cValue ) == eCC_Whitespace;
 	}
 
 	static bool isNonLiteral( char cValue ) {
-		return cValue == '{' || cValue == '}' || cValue == '[' || cValue == ']' || cValue == ';' || cValue == ':' || cValue == ',' || cValue == '/';
+		return IdlScan::classify( cValue ) == eCC_Delimiter;
 	}
 
 	static eTok getNonLiteralType( char cValue ) {
@@ -112,35 +202,31 @@ protected:
 		return eTok_UNKNOWN;
 	}
 
+	static eTok getKeywordType( std::string_view sText ) {
+		return (eTok)eTok_KeywordTable.lookup( sText.data(), sText.size(), eTok_UNKNOWN );
+	}
+
 	SToken _readToken( )
 	{
 		bool bInComment = false;
 		bool bCommentStarted = false;
 		bool bTokenStarted = false;
+		const char *pcTokBegin = nullptr;
+		const char *pcTokEnd = nullptr;
 		SToken xToken;
 
 		while( !isEof() ) {
-			int cValue = fgetc( m_fHandle );
-			if( cValue == EOF ) continue;
-
-			// Update line number info
-			if( cValue == '\n' ) {
-				m_iLineNum++;
-			}
-
-			// +++ Ignore Windows Fail Newlines
-			if( cValue == '\r' ) continue;
-			// ---
+			int cValue = *m_pcCur++;
 
 			// +++ Handle Comments
 			if( !bInComment ) {
 				if( cValue == '/' ) {
-					char cValue2 = fgetc( m_fHandle );
-					if( cValue2 == '/' ) {
+					if( !isEof() && *m_pcCur == '/' ) {
+						m_pcCur++;
 						bInComment = true;
 						continue;
 					} else {
-						throw LexException( m_iLineNum, "unexpected '/' literal" );
+						throw LexException( lineAt(m_pcCur - 1), "unexpected '/' literal" );
 					}
 				}
 			} else {
@@ -153,13 +239,13 @@ protected:
 			/* TOKENIZE COMMENTS
 			if( !bInComment ) {
 				if( cValue == '/' ) {
-					char cValue2 = fgetc( m_fHandle );
-					if( cValue2 == '/' ) {
+					if( !isEof() && *m_pcCur == '/' ) {
+						m_pcCur++;
 						bInComment = true;
 						xToken.iType = eTok_COMMENT;
 						continue;
 					} else {
-						throw LexException( m_iLineNum, "unexpected '/' literal" );
+						throw LexException( lineAt(m_pcCur - 1), "unexpected '/' literal" );
 					}
 				}
 			} else {
@@ -182,11 +268,12 @@ protected:
 			// --- Handle Comments
 
 			// +++ Don't Lex Whitespace +++
+			// ('\r' is whitespace, so Windows newlines need no special case)
 			if( bTokenStarted ) {
 				if( isWhitespace(cValue) ) {
 					break;
 				} else if( isNonLiteral(cValue) ) {
-					fseek( m_fHandle, -1, SEEK_CUR );
+					m_pcCur--;
 					break;
 				}
 			} else {
@@ -194,57 +281,51 @@ protected:
 					continue;
 				} else {
 					bTokenStarted = true;
-					xToken.iLineNum = m_iLineNum;
+					pcTokBegin = m_pcCur - 1;
+					xToken.iOffset = (unsigned int)( pcTokBegin - m_pcBegin );
 				}
 			}
 			// --- Don't Lex Whitespace ---
 
 			if( isNonLiteral(cValue) ) {
 				xToken.iType = getNonLiteralType( cValue );
-				xToken.sText.push_back( cValue );
+				xToken.sText = std::string_view( pcTokBegin, 1 );
 				return xToken;
 			}
 
 			xToken.iType = eTok_LITERAL;
-			xToken.sText.push_back( cValue );
+			pcTokEnd = m_pcCur;
 		}
 
-		if( isEof() && xToken.sText.size() == 0 ) {
+		if( bTokenStarted ) {
+			xToken.sText = std::string_view( pcTokBegin, pcTokEnd - pcTokBegin );
+		} else if( isEof() ) {
 			xToken.iType = eTok_EOF;
+			xToken.iOffset = (unsigned int)( m_pcEnd - m_pcBegin );
 		}
 
 		if( xToken.iType == eTok_UNKNOWN ) {
-			throw LexException( m_iLineNum, "bad token" );
-		}
-
-		eTok iNewType = eTok_UNKNOWN;
-		if( xToken.sText == "message" ) {
-			iNewType = eTok_KEY_MESSAGE;
-		} else if( xToken.sText == "base" ) {
-			iNewType = eTok_KEY_BASE;
-		} else if( xToken.sText == "enum" ) {
-			iNewType = eTok_KEY_ENUM;
-		} else if( xToken.sText == "namespace" ) {
-			iNewType = eTok_KEY_NAMESPACE;
-		} else if( xToken.sText == "@type" ) {
-			iNewType = eTok_KEY_TYPEDEF;
-		} else if( xToken.sText == "list" ) {
-			iNewType = eTok_KEY_LIST;
+			throw LexException( lineAt(m_pcCur), "bad token" );
 		}
 
+		eTok iNewType = getKeywordType( xToken.sText );
 		if( iNewType != eTok_UNKNOWN ) {
 			if( xToken.iType != eTok_LITERAL ) {
-				throw LexException( m_iLineNum, "invalid use of language keyword" );
+				throw LexException( lineAt(pcTokBegin), "invalid use of language keyword" );
 			}
 			xToken.iType = iNewType;
 		}
 
+		if( xToken.iType == eTok_LITERAL ) {
+			xToken.iSymbol = m_pSymbols->intern( xToken.sText );
+		}
+
 		return xToken;
 	}
 
 public:
-	IdlLexer( FILE *fHandle ) 
-		: m_fHandle(fHandle), m_iLineNum(1)
+	IdlLexer( const IdlInput *pInput, IdlSymbols *pSymbols ) 
+		: m_pInput(pInput), m_pSymbols(pSymbols), m_pcBegin(pInput->begin()), m_pcCur(pInput->begin()), m_pcEnd(pInput->end())
 	{
 	}
 
@@ -258,7 +339,7 @@ public:
 
 		SToken xToken = _readToken( );
 
-		//printf( "% 14s - %s\n", eTok_Names[xToken.iType], xToken.sText.c_str() );
+		//printf( "% 14s - %.*s\n", eTok_Names[xToken.iType], (int)xToken.sText.size(), xToken.sText.data() );
 
 		return xToken;
 	}
@@ -270,11 +351,64 @@ public:
 		return xToken;
 	}
 
+	// Lexes the remainder of the input in one pass. The list always
+	//  ends with an eTok_EOF token. This is the fast path: it skips
+	//  whitespace and finds literal ends through IdlScan instead of
+	//  stepping one byte at a time, and never counts lines.
+	void tokenize( IdlTokenList& xTokens )
+	{
+		xTokens.reset( m_pcBegin );
+		xTokens.reserve( (m_pcEnd - m_pcCur) / 4 );
+
+		for( auto i = m_asPeeks.rbegin(); i != m_asPeeks.rend(); ++i ) {
+			xTokens.add( *i );
+		}
+		m_asPeeks.clear( );
+
+		while( true ) {
+			m_pcCur = IdlScan::skip_whitespace( m_pcCur, m_pcEnd );
+			if( isEof() ) {
+				break;
+			}
+
+			const char *pcTokBegin = m_pcCur;
+			unsigned int iOffset = (unsigned int)( pcTokBegin - m_pcBegin );
+			char cValue = *m_pcCur;
+
+			if( cValue == '/' ) {
+				if( m_pcEnd - m_pcCur < 2 || m_pcCur[1] != '/' ) {
+					throw LexException( lineAt(m_pcCur), "unexpected '/' literal" );
+				}
+				m_pcCur = IdlScan::find_newline( m_pcCur + 2, m_pcEnd );
+				continue;
+			}
+
+			if( isNonLiteral(cValue) ) {
+				m_pcCur++;
+				xTokens.add( getNonLiteralType(cValue), iOffset, 1 );
+				continue;
+			}
+
+			m_pcCur = IdlScan::find_literal_end( m_pcCur + 1, m_pcEnd );
+			unsigned int iLength = (unsigned int)( m_pcCur - pcTokBegin );
+
+			std::string_view sText( pcTokBegin, iLength );
+			eTok iType = getKeywordType( sText );
+			if( iType != eTok_UNKNOWN ) {
+				xTokens.add( iType, iOffset, iLength );
+			} else {
+				xTokens.add( eTok_LITERAL, iOffset, iLength, m_pSymbols->intern(sText) );
+			}
+		}
+
+		xTokens.add( eTok_EOF, (unsigned int)( m_pcEnd - m_pcBegin ), 0 );
+	}
+
 	bool dbgOutput( )
 	{
 		while( !isEof() ) {
 			SToken xToken = readToken( );
-			printf( "% 14s - %s\n", eTok_Names[xToken.iType], xToken.sText.c_str() );
+			printf( "% 14s - %.*s\n", eTok_Names[xToken.iType], (int)xToken.sText.size(), xToken.sText.data() );
 		}
 
 		return true;
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <new>
+#include "IdlProfile.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Growable in-memory sink for generated code. Lines are formatted straight
+//  into the buffer behind a cached indentation prefix, and the finished text
+//  is handed to a file in a single write or returned to the caller. The
+//  buffer grows with realloc, which lets large blocks be remapped in place
+//  instead of zero-filled and copied.
+class IdlOutput
+{
+protected:
+	char *m_pcBuffer;
+	size_t m_iCapacity;
+	size_t m_iLength;
+
+	std::string m_sIndentUnit;
+	std::string m_sIndentCache;
+	int m_iIndent;
+
+	void _reserve( size_t iExtra )
+	{
+		size_t iNeed = m_iLength + iExtra + 1;
+		if( iNeed > m_iCapacity ) {
+			size_t iSize = m_iCapacity * 2;
+			if( iSize < iNeed ) {
+				iSize = iNeed;
+			}
+
+			char *pcBuffer = (char*)realloc( m_pcBuffer, iSize );
+			if( !pcBuffer ) {
+				throw std::bad_alloc( );
+			}
+			SAllocCounters& xAllocs = SAllocCounters::local( );
+			xAllocs.release( m_iCapacity );
+			xAllocs.alloc( iSize );
+			m_pcBuffer = pcBuffer;
+			m_iCapacity = iSize;
+		}
+	}
+
+	void _indent( )
+	{
+		if( m_iIndent <= 0 ) {
+			return;
+		}
+
+		size_t iLength = m_iIndent * m_sIndentUnit.size( );
+		while( m_sIndentCache.size() < iLength ) {
+			m_sIndentCache += m_sIndentUnit;
+		}
+		append( m_sIndentCache.data(), iLength );
+	}
+
+	void _appendInt( int iValue )
+	{
+		char acNum[16];
+		unsigned int uValue = iValue < 0 ? 0u - (unsigned int)iValue : (unsigned int)iValue;
+		char *pcNum = acNum + sizeof(acNum);
+		do {
+			*--pcNum = (char)( '0' + uValue % 10 );
+			uValue /= 10;
+		} while( uValue );
+		if( iValue < 0 ) {
+			*--pcNum = '-';
+		}
+		append( pcNum, acNum + sizeof(acNum) - pcNum );
+	}
+
+	// Formats directly when the only conversions are %s, %d and %%, which
+	//  covers nearly every generated line and skips the setup vsnprintf
+	//  pays on each call. Returns false, having written nothing, for any
+	//  other conversion.
+	bool _formatSimple( const char *pcFormat, va_list args )
+	{
+		for( const char *p = strchr( pcFormat, '%' ); p; p = strchr( p + 2, '%' ) ) {
+			if( p[1] != 's' && p[1] != 'd' && p[1] != '%' ) {
+				return false;
+			}
+		}
+
+		const char *pcRun = pcFormat;
+		for( const char *p = strchr( pcRun, '%' ); p; p = strchr( pcRun, '%' ) ) {
+			append( pcRun, p - pcRun );
+			if( p[1] == 's' ) {
+				const char *pcArg = va_arg( args, const char* );
+				append( pcArg, strlen(pcArg) );
+			} else if( p[1] == 'd' ) {
+				_appendInt( va_arg( args, int ) );
+			} else {
+				append( "%", 1 );
+			}
+			pcRun = p + 2;
+		}
+		append( pcRun, strlen(pcRun) );
+		return true;
+	}
+
+public:
+	IdlOutput( const char *pcIndentUnit = "\t" )
+		: m_pcBuffer(nullptr), m_iCapacity(0), m_iLength(0), m_sIndentUnit(pcIndentUnit), m_iIndent(0)
+	{
+		_reserve( 64 * 1024 );
+	}
+
+	~IdlOutput( )
+	{
+		SAllocCounters::local().release( m_iCapacity );
+		free( m_pcBuffer );
+	}
+
+	void indent( int iDelta )
+	{
+		m_iIndent += iDelta;
+	}
+
+	void append( const char *pcText, size_t iLength )
+	{
+		_reserve( iLength );
+		memcpy( m_pcBuffer + m_iLength, pcText, iLength );
+		m_iLength += iLength;
+	}
+
+	void vtext( const char *pcFormat, va_list args )
+	{
+		va_list argsCopy;
+		va_copy( argsCopy, args );
+		bool bDone = _formatSimple( pcFormat, argsCopy );
+		va_end( argsCopy );
+		if( bDone ) {
+			return;
+		}
+
+		va_copy( argsCopy, args );
+		size_t iSpace = m_iCapacity - m_iLength;
+		int iLength = vsnprintf( m_pcBuffer + m_iLength, iSpace, pcFormat, args );
+		if( iLength >= 0 && (size_t)iLength >= iSpace ) {
+			_reserve( iLength );
+			vsnprintf( m_pcBuffer + m_iLength, m_iCapacity - m_iLength, pcFormat, argsCopy );
+		}
+		va_end( argsCopy );
+
+		if( iLength > 0 ) {
+			m_iLength += iLength;
+		}
+	}
+
+	void vline( const char *pcFormat, va_list args )
+	{
+		_indent( );
+		vtext( pcFormat, args );
+	}
+
+	// Formatted text at the current indentation
+	void line( const char *pcFormat, ... )
+	{
+		va_list args;
+		va_start( args, pcFormat );
+		vline( pcFormat, args );
+		va_end( args );
+	}
+
+	// Formatted text with no indentation
+	void text( const char *pcFormat, ... )
+	{
+		va_list args;
+		va_start( args, pcFormat );
+		vtext( pcFormat, args );
+		va_end( args );
+	}
+
+	const char* data( ) const { return m_pcBuffer; }
+	size_t size( ) const { return m_iLength; }
+	std::string str( ) const { return std::string( m_pcBuffer, m_iLength ); }
+
+	void clear_indent( )
+	{
+		m_iIndent = 0;
+	}
+
+	void clear( )
+	{
+		m_iLength = 0;
+		m_iIndent = 0;
+	}
+
+	bool write( FILE *fHandle ) const
+	{
+		return fwrite( m_pcBuffer, 1, m_iLength, fHandle ) == m_iLength;
+	}
+
+	bool write_file( const char *pcPath ) const
+	{
+		FILE *fHandle = fopen( pcPath, "wb" );
+		if( !fHandle ) {
+			return false;
+		}
+
+		bool bResult = write( fHandle );
+		if( fclose( fHandle ) != 0 ) {
+			bResult = false;
+		}
+		return bResult;
+	}
+
+	// Creates an output directory unless it exists; its parent must
+	static void make_dir( const char *pcDir )
+	{
+#ifdef _WIN32
+		_mkdir( pcDir );
+#else
+		mkdir( pcDir, 0777 );
+#endif
+	}
+
+private:
+	IdlOutput( const IdlOutput& );
+	IdlOutput& operator=( const IdlOutput& );
+};
@@ -3,6 +3,7 @@
 #include <exception>
 #include <vector>
 #include "IdlLexer.h"
+#include "IdlAst.h"
 
 class ParseTokException : public std::exception
 {
@@ -22,284 +23,112 @@ class ParseException : public std::exception
 {
 };
 
-enum eParseType
-{
-	ePT_Unknown = 0,
-	ePT_Root,
-	ePT_Typedef,
-	ePT_Enum,
-	ePT_Namespace,
-	ePT_Message,
-	ePT_Base,
-	ePT_List,
-	ePT_Var
-};
-
-static char* ePT_Names[] = {
-	"UNKNOWN",
-	"ROOT",
-	"TYPEDEF",
-	"ENUM",
-	"NAMESPACE",
-	"MESSAGE",
-	"BASE",
-	"LIST",
-	"VAR"
-};
-
-class PTContainer;
-
-class PTElement
-{
-protected:
-	int m_iLineNum;
-	PTContainer *m_pParent;
-
-public:
-	PTElement( ) : m_pParent(0), m_iLineNum(0) { }
-	virtual ~PTElement( ) { }
-
-	virtual eParseType type() const { return ePT_Unknown; }
-	virtual std::string name() const { return ""; }
-
-	void set_linenum( int iLineNum ) { m_iLineNum = iLineNum; }
-	int line_num( ) const { return m_iLineNum; }
-
-	void set_parent( PTContainer *pParent ) { m_pParent = pParent; }
-	PTContainer* get_parent( ) const { return m_pParent; }
-
-};
-
-class PTContainer : public PTElement
+class IdlParser
 {
 protected:
-	std::vector<PTElement*> m_vChildren;
-
-public:
-	const std::vector<PTElement*>& get_children( ) const { return m_vChildren; }
-	size_t get_child_cnt( ) const { return m_vChildren.size(); }
-	PTElement* get_child( int iIdx ) const { return m_vChildren[iIdx]; }
-
-	void add_child( PTElement *pChild )
+	const IdlTokenList *m_pTokens;
+	size_t m_iPos;
+	IdlAst m_xAst;
+	AstIdx m_iCurNode;
+	std::vector<AstIdx> m_viPending;
+
+	// Finished nodes are queued here until their container closes, at
+	//  which point the container's whole child list is stored as one run.
+	void addChild( AstIdx iNode )
 	{
-		m_vChildren.push_back( pChild );
+		m_viPending.push_back( iNode );
 	}
 
-};
-
-class PTRoot : public PTContainer
-{
-public:
-	virtual eParseType type() const { return ePT_Root; }
-
-};
-
-class PTTypedef : public PTElement
-{
-protected:
-	std::string m_sType;
-	std::string m_sName;
-
-public:
-	virtual eParseType type() const { return ePT_Typedef; }
-	virtual std::string name() const { return m_sName; }
-
-	std::string get_name( ) const { return m_sName; }
-	std::string get_type( ) const { return m_sType; }
-	
-	void set_name( const std::string& sName ) { m_sName = sName; }
-	void set_type( const std::string& sType ) { m_sType = sType; }
-
-};
-
-class PTNamespace : public PTContainer
-{
-protected:
-	std::string m_sName;
-
-public:
-	virtual eParseType type() const { return ePT_Namespace; }
-
-	std::string get_name( ) const { return m_sName; }
-
-	void set_name( const std::string& sName ) { m_sName = sName; }
-
-};
-
-class PTEnum : public PTElement
-{
-protected:
-	std::string m_sName;
-	std::vector<std::string> m_vValues;
-
-public:
-	virtual eParseType type() const { return ePT_Enum; }
-	virtual std::string name() const { return m_sName; }
-
-	std::string get_name( ) const { return m_sName; }
-	const std::vector<std::string>& get_values( ) const { return m_vValues; }
-	size_t get_value_cnt( ) const { return m_vValues.size(); }
-	std::string get_value( int iIdx ) const { return m_vValues[iIdx]; }
-
-	void set_name( const std::string& sName ) { m_sName = sName; }
-	void add_value( const std::string& sName ) { m_vValues.push_back( sName ); }
-
-};
-
-class PTXMsgNBase : public PTContainer
-{
-protected:
-	std::string m_sName;
-	std::vector<std::string> m_vInherit;
-
-public:
-	virtual eParseType type() const { return ePT_Unknown; }
-	virtual std::string name() const { return m_sName; }
-
-	std::string get_name( ) const { return m_sName; }
-	const std::vector<std::string>& get_inherits( ) const { return m_vInherit; }
-	size_t get_inherit_cnt( ) const { return m_vInherit.size( ); }
-	std::string get_inherit( int iIdx ) const { return m_vInherit[iIdx]; }
-
-	void set_name( const std::string& sName ) { m_sName = sName; }
-	void add_inherit( const std::string& sName ) { m_vInherit.push_back(sName); }
-
-};
-
-class PTList : public PTXMsgNBase
-{
-protected:
-
-public:
-	virtual eParseType type() const { return ePT_List; }
-
-};
-
-class PTMessage : public PTXMsgNBase
-{
-protected:
-
-public:
-	virtual eParseType type() const { return ePT_Message; }
-
-};
-
-class PTBase : public PTXMsgNBase
-{
-protected:
-
-public:
-	virtual eParseType type() const { return ePT_Base; }
-
-};
-
-class PTVar : public PTElement
-{
-protected:
-	std::string m_sName;
-	std::string m_sType;
-	std::string m_sArrLen;
-
-public:
-	virtual eParseType type() const { return ePT_Var; }
-	virtual std::string name() const { return m_sName; }
-
-	std::string get_name( ) const { return m_sName; }
-	std::string get_type( ) const { return m_sType; }
-	std::string get_arrlen( ) const { return m_sArrLen; }
-
-	void set_name( const std::string& sName ) { m_sName = sName; }
-	void set_type( const std::string& sType ) { m_sType = sType; }
-	void set_arrlen( const std::string& sArrLen ) { m_sArrLen = sArrLen; }
-
-};
+	SToken readToken( )
+	{
+		SToken xToken = m_pTokens->get( m_iPos );
+		if( m_iPos + 1 < m_pTokens->size() ) {
+			m_iPos++;
+		}
+		return xToken;
+	}
 
-class IdlParser
-{
-protected:
-	IdlLexer *m_pLexer;
-	PTRoot *m_pRoot;
-	PTContainer *m_pCurNode;
+	SToken peekToken( size_t iAhead = 0 ) const
+	{
+		size_t iIdx = m_iPos + iAhead;
+		if( iIdx >= m_pTokens->size() ) {
+			iIdx = m_pTokens->size() - 1;
+		}
+		return m_pTokens->get( iIdx );
+	}
 
 public:
-	IdlParser( IdlLexer *pLexer )
-		: m_pLexer(pLexer )
+	IdlParser( const IdlTokenList *pTokens, const IdlSymbols *pSymbols )
+		: m_pTokens(pTokens), m_iPos(0), m_xAst(pSymbols)
 	{
-		m_pRoot = new PTRoot( );
-		m_pCurNode = m_pRoot;
+		m_iCurNode = m_xAst.add_node( ePT_Root, AST_NONE, 0 );
 	}
 
 	bool parseTypedef( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_TYPEDEF ) {
 			throw ParseTokException( xKeyword, "typedef keyword expected eTok_KEY_ENUM" );
 		}
 
-		SToken xType = m_pLexer->readToken();
+		SToken xType = readToken();
 		if( xType.iType != eTok_LITERAL ) {
 			throw ParseTokException( xType, "typedef type expected eTok_LITERAL" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "typedef name expected eTok_LITERAL" );
 		}
 
-		SToken xTerm = m_pLexer->readToken();
+		SToken xTerm = readToken();
 		if( xTerm.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xTerm, "typedef terminator expected eTok_TERMINATOR" );
 		}
 	
-		PTTypedef* pNode = new PTTypedef( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
-		pNode->set_type( xType.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Typedef, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
+		m_xAst.add_ref( iNode, xType.iSymbol );
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 		
 		return true;
 	}
 
 	bool parseEnum( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_ENUM ) {
 			throw ParseTokException( xKeyword, "enum keyword expected eTok_KEY_ENUM" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "enum name expected eTok_LITERAL" );
 		}
 
-		PTEnum* pNode = new PTEnum( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Enum, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
 
 		SToken xToken;
-		xToken = m_pLexer->readToken( );
+		xToken = readToken( );
 		if( xToken.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xKeyword, "enum expected eTok_BRACE_OPEN" );
 		}
 
 		// Check for empty enum
-		xToken = m_pLexer->peekToken( );
+		xToken = peekToken( );
 		if( xToken.iType != eTok_BRACE_CLOSE ) {
 
 			// Loop all the enum values
 			while( true ) {
 
-				xToken = m_pLexer->readToken( );
+				xToken = readToken( );
 				if( xToken.iType != eTok_LITERAL ) {
 					throw ParseTokException( xToken, "enum expected eTok_LITERAL" );
 				}
 
-				pNode->add_value( xToken.sText );
+				m_xAst.add_ref( iNode, xToken.iSymbol );
 
-				xToken = m_pLexer->readToken( );
+				xToken = readToken( );
 				if( xToken.iType != eTok_BRACE_CLOSE && xToken.iType != eTok_COMMA ) {
 					throw ParseTokException( xToken, "enum expected eTok_BRACE_CLOSE or eTok_COMMA" );
 				}
@@ -309,145 +138,136 @@ public:
 			}
 		}
 
-		xToken = m_pLexer->readToken( );
+		xToken = readToken( );
 		if( xToken.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xToken, "enum expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
 	bool parseNamespace( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_NAMESPACE ) {
 			throw ParseTokException( xKeyword, "namespace keyword expected eTok_KEY_NAMESPACE" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "namespace name expected eTok_LITERAL" );
 		}
 
-		PTNamespace* pNode = new PTNamespace( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Namespace, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
 
-		SToken xBegin = m_pLexer->readToken( );
+		SToken xBegin = readToken( );
 		if( xBegin.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xBegin, "namespace beginning expected eTok_BRACE_OPEN" );
 		}
 
-		_pushAndParse( pNode );
+		_pushAndParse( iNode );
 
-		SToken xEnd = m_pLexer->readToken( );
+		SToken xEnd = readToken( );
 		if( xEnd.iType != eTok_BRACE_CLOSE ) {
 			throw ParseTokException( xEnd, "namespace ending expected eTok_BRACE_CLOSE" );
 		}
 
-		SToken xTerminator = m_pLexer->readToken( );
+		SToken xTerminator = readToken( );
 		if( xTerminator.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xEnd, "namespace terminator expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
 	bool parseVar( )
 	{
-		SToken xType = m_pLexer->readToken( );
+		SToken xType = readToken( );
 		if( xType.iType != eTok_LITERAL ) {
 			throw ParseTokException( xType, "var type expected eTok_LITERAL" );
 		}
 
-		SToken xName = m_pLexer->readToken( );
+		SToken xName = readToken( );
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "var name expected eTok_LITERAL" );
 		}
 
-		PTVar* pNode = new PTVar( );
-		pNode->set_linenum( xName.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
-		pNode->set_type( xType.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Var, m_iCurNode, xName.iOffset, xName.iSymbol );
+		m_xAst.add_ref( iNode, xType.iSymbol );
 
-		SToken xToken = m_pLexer->peekToken( );
+		SToken xToken = peekToken( );
 		if( xToken.iType != eTok_TERMINATOR && xToken.iType != eTok_ARR_OPEN ) {
 			throw ParseTokException( xToken, "var expected eTok_TERMINATOR or eTok_ARR_OPEN" );
 		}
 
 		if( xToken.iType == eTok_ARR_OPEN ) {
 
-			SToken xArrOpen = m_pLexer->readToken( );
+			SToken xArrOpen = readToken( );
 			// Already validated above
 
-			SToken xArrSize = m_pLexer->readToken( );
+			SToken xArrSize = readToken( );
 			if( xArrSize.iType != eTok_LITERAL ) {
 				throw ParseTokException( xArrSize, "var array size expected eTok_LITERAL" );
 			}
 
-			pNode->set_arrlen( xArrSize.sText );
+			m_xAst.add_ref( iNode, xArrSize.iSymbol );
 
-			SToken xArrClose = m_pLexer->readToken( );
+			SToken xArrClose = readToken( );
 			if( xArrClose.iType != eTok_ARR_CLOSE ) {
 				throw ParseTokException( xArrClose, "var array closer expected eTok_ARR_CLOSE" );
 			}
 		}
 
-		SToken xTerminator = m_pLexer->readToken( );
+		SToken xTerminator = readToken( );
 		if( xTerminator.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xTerminator, "var terminator expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
 	bool parseMessage( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_MESSAGE ) {
 			throw ParseTokException( xKeyword, "message keyword expected eTok_KEY_MESSAGE" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "message name expected eTok_LITERAL" );
 		}
 
-		PTMessage* pNode = new PTMessage( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Message, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
 
-		SToken xToken = m_pLexer->peekToken( );
+		SToken xToken = peekToken( );
 		if( xToken.iType != eTok_SEPERATOR && xToken.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "message expected eTok_BRACE_OPEN or eTok_SEPERATOR" );
 		}
 
 		if( xToken.iType == eTok_SEPERATOR ) {
 
-			SToken xSeperator = m_pLexer->readToken( );
+			SToken xSeperator = readToken( );
 			// Already validated above
 
 			while( true ) {
-				SToken xIName = m_pLexer->readToken( );
+				SToken xIName = readToken( );
 				if( xIName.iType != eTok_LITERAL ) {
 					throw ParseTokException( xToken, "message inherit name expected eTok_LITERAL" );
 				}
 
-				pNode->add_inherit( xIName.sText );
+				m_xAst.add_ref( iNode, xIName.iSymbol );
 
-				SToken xNextSep = m_pLexer->peekToken( );
+				SToken xNextSep = peekToken( );
 				if( xNextSep.iType == eTok_COMMA ) {
 					// Skip the token and continue
-					m_pLexer->readToken( );
+					readToken( );
 				} else if( xNextSep.iType == eTok_BRACE_OPEN ) {
 					// Stop gathering inheritances!
 					break;
@@ -457,67 +277,64 @@ public:
 			}
 		}
 
-		SToken xBegin = m_pLexer->readToken( );
+		SToken xBegin = readToken( );
 		if( xBegin.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "message beginning expected eTok_BRACE_OPEN" );
 		}
 
-		_pushAndParse( pNode );
+		_pushAndParse( iNode );
 
-		SToken xEnd = m_pLexer->readToken( );
+		SToken xEnd = readToken( );
 		if( xEnd.iType != eTok_BRACE_CLOSE ) {
 			throw ParseTokException( xEnd, "message ending expected eTok_BRACE_CLOSE" );
 		}
 
-		SToken xTerminator = m_pLexer->readToken( );
+		SToken xTerminator = readToken( );
 		if( xTerminator.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xEnd, "message terminator expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
 	bool parseBase( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_BASE ) {
 			throw ParseTokException( xKeyword, "base keyword expected eTok_KEY_MESSAGE" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "base name expected eTok_LITERAL" );
 		}
 
-		PTBase* pNode = new PTBase( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_Base, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
 
-		SToken xToken = m_pLexer->peekToken( );
+		SToken xToken = peekToken( );
 		if( xToken.iType != eTok_SEPERATOR && xToken.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "base expected eTok_BRACE_OPEN or eTok_SEPERATOR" );
 		}
 
 		if( xToken.iType == eTok_SEPERATOR ) {
 
-			SToken xSeperator = m_pLexer->readToken( );
+			SToken xSeperator = readToken( );
 			// Already validated above
 
 			while( true ) {
-				SToken xIName = m_pLexer->readToken( );
+				SToken xIName = readToken( );
 				if( xIName.iType != eTok_LITERAL ) {
 					throw ParseTokException( xToken, "base inherit name expected eTok_LITERAL" );
 				}
 
-				pNode->add_inherit( xIName.sText );
+				m_xAst.add_ref( iNode, xIName.iSymbol );
 
-				SToken xNextSep = m_pLexer->peekToken( );
+				SToken xNextSep = peekToken( );
 				if( xNextSep.iType == eTok_COMMA ) {
 					// Skip the token and continue
-					m_pLexer->readToken( );
+					readToken( );
 				} else if( xNextSep.iType == eTok_BRACE_OPEN ) {
 					// Stop gathering inheritances!
 					break;
@@ -527,67 +344,64 @@ public:
 			}
 		}
 
-		SToken xBegin = m_pLexer->readToken( );
+		SToken xBegin = readToken( );
 		if( xBegin.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "base beginning expected eTok_BRACE_OPEN" );
 		}
 
-		_pushAndParse( pNode );
+		_pushAndParse( iNode );
 
-		SToken xEnd = m_pLexer->readToken( );
+		SToken xEnd = readToken( );
 		if( xEnd.iType != eTok_BRACE_CLOSE ) {
 			throw ParseTokException( xEnd, "base ending expected eTok_BRACE_CLOSE" );
 		}
 
-		SToken xTerminator = m_pLexer->readToken( );
+		SToken xTerminator = readToken( );
 		if( xTerminator.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xEnd, "base terminator expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
 	bool parseList( )
 	{
-		SToken xKeyword = m_pLexer->readToken();
+		SToken xKeyword = readToken();
 		if( xKeyword.iType != eTok_KEY_LIST ) {
 			throw ParseTokException( xKeyword, "list keyword expected eTok_KEY_LIST" );
 		}
 
-		SToken xName = m_pLexer->readToken();
+		SToken xName = readToken();
 		if( xName.iType != eTok_LITERAL ) {
 			throw ParseTokException( xName, "list name expected eTok_LITERAL" );
 		}
 
-		PTList* pNode = new PTList( );
-		pNode->set_linenum( xKeyword.iLineNum );
-		pNode->set_parent( m_pCurNode );
-		pNode->set_name( xName.sText );
+		AstIdx iNode = m_xAst.add_node( ePT_List, m_iCurNode, xKeyword.iOffset, xName.iSymbol );
 
-		SToken xToken = m_pLexer->peekToken( );
+		SToken xToken = peekToken( );
 		if( xToken.iType != eTok_SEPERATOR && xToken.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "list expected eTok_BRACE_OPEN or eTok_SEPERATOR" );
 		}
 
 		if( xToken.iType == eTok_SEPERATOR ) {
 
-			SToken xSeperator = m_pLexer->readToken( );
+			SToken xSeperator = readToken( );
 			// Already validated above
 
 			while( true ) {
-				SToken xIName = m_pLexer->readToken( );
+				SToken xIName = readToken( );
 				if( xIName.iType != eTok_LITERAL ) {
 					throw ParseTokException( xToken, "list inherit name expected eTok_LITERAL" );
 				}
 
-				pNode->add_inherit( xIName.sText );
+				m_xAst.add_ref( iNode, xIName.iSymbol );
 
-				SToken xNextSep = m_pLexer->peekToken( );
+				SToken xNextSep = peekToken( );
 				if( xNextSep.iType == eTok_COMMA ) {
 					// Skip the token and continue
-					m_pLexer->readToken( );
+					readToken( );
 				} else if( xNextSep.iType == eTok_BRACE_OPEN ) {
 					// Stop gathering inheritances!
 					break;
@@ -597,41 +411,44 @@ public:
 			}
 		}
 
-		SToken xBegin = m_pLexer->readToken( );
+		SToken xBegin = readToken( );
 		if( xBegin.iType != eTok_BRACE_OPEN ) {
 			throw ParseTokException( xToken, "list beginning expected eTok_BRACE_OPEN" );
 		}
 
-		_pushAndParse( pNode );
+		_pushAndParse( iNode );
 
-		SToken xEnd = m_pLexer->readToken( );
+		SToken xEnd = readToken( );
 		if( xEnd.iType != eTok_BRACE_CLOSE ) {
 			throw ParseTokException( xEnd, "list ending expected eTok_BRACE_CLOSE" );
 		}
 
-		SToken xTerminator = m_pLexer->readToken( );
+		SToken xTerminator = readToken( );
 		if( xTerminator.iType != eTok_TERMINATOR ) {
 			throw ParseTokException( xEnd, "list terminator expected eTok_TERMINATOR" );
 		}
 
-		m_pCurNode->add_child( pNode );
+		addChild( iNode );
 
 		return true;
 	}
 
-	bool _pushAndParse( PTContainer *pNode ) 
+	bool _pushAndParse( AstIdx iNode ) 
 	{
-		PTContainer *pLastNode = m_pCurNode;
-		m_pCurNode = pNode;
+		AstIdx iLastNode = m_iCurNode;
+		size_t iMark = m_viPending.size( );
+		m_iCurNode = iNode;
 		bool bRetVal = _parse( );
-		m_pCurNode = pLastNode;
+		m_xAst.set_children( iNode, m_viPending.data() + iMark, m_viPending.size() - iMark );
+		m_viPending.resize( iMark );
+		m_iCurNode = iLastNode;
 		return bRetVal;
 	}
 
 	bool _parse( )
 	{
 		while( true ) {
-			SToken xToken = m_pLexer->peekToken( );
+			SToken xToken = peekToken( );
 
 			if( xToken.iType == eTok_EOF || xToken.iType == eTok_BRACE_CLOSE ) {
 				break;
@@ -662,9 +479,9 @@ public:
 
 	bool parse( )
 	{
-		_parse( );
+		_pushAndParse( AST_ROOT );
 
-		SToken xToken = m_pLexer->readToken( );
+		SToken xToken = readToken( );
 		if( xToken.iType != eTok_EOF ) {
 			throw ParseTokException( xToken, "unexpected end-of-file" );
 		}
@@ -672,94 +489,98 @@ public:
 		return true;
 	}
 
-	PTRoot* get_root( ) const { return m_pRoot; }
+	const IdlAst& get_ast( ) const { return m_xAst; }
+	IdlAst& get_ast( ) { return m_xAst; }
 
 	void _dbgTabs( int iLvl ) {
 		for( int i = 0; i < iLvl; ++i ) printf( "  " );
 	}
 
-	void _dbgOutEnum( PTEnum* pNode, int iLvl )
+	void _dbgOutEnum( AstIdx iNode, int iLvl )
 	{
-		_dbgTabs(iLvl); printf( "Name: '%s'\n", pNode->get_name().c_str() );
+		_dbgTabs(iLvl); printf( "Name: '%s'\n", m_xAst.name(iNode) );
 		_dbgTabs(iLvl); printf( "Values:\n" );
-		for( auto i = pNode->get_values().begin(); i != pNode->get_values().end(); ++i ) {
-			_dbgTabs(iLvl+1); printf( "'%s'\n", (*i).c_str() );
+		for( auto i = m_xAst.refs(iNode).begin(); i != m_xAst.refs(iNode).end(); ++i ) {
+			_dbgTabs(iLvl+1); printf( "'%s'\n", m_xAst.str(*i) );
 		}
 	}
 
-	void _dbgOutTypedef( PTTypedef* pNode, int iLvl )
+	void _dbgOutTypedef( AstIdx iNode, int iLvl )
 	{
-		_dbgTabs(iLvl); printf( "Name: '%s'\n", pNode->get_name().c_str() );
-		_dbgTabs(iLvl); printf( "Value: '%s'\n", pNode->get_type().c_str() );
+		_dbgTabs(iLvl); printf( "Name: '%s'\n", m_xAst.name(iNode) );
+		_dbgTabs(iLvl); printf( "Value: '%s'\n", m_xAst.var_type(iNode) );
 	}
 
-	void _dbgOutVar( PTVar* pNode, int iLvl )
+	void _dbgOutVar( AstIdx iNode, int iLvl )
 	{
-		_dbgTabs(iLvl); printf( "Name: '%s'\n", pNode->get_name().c_str() );
-		_dbgTabs(iLvl); printf( "Value: '%s'\n", pNode->get_type().c_str() );
-		_dbgTabs(iLvl); printf( "ArrLen: '%s'\n", pNode->get_arrlen().c_str() );
+		_dbgTabs(iLvl); printf( "Name: '%s'\n", m_xAst.name(iNode) );
+		_dbgTabs(iLvl); printf( "Value: '%s'\n", m_xAst.var_type(iNode) );
+		_dbgTabs(iLvl); printf( "ArrLen: '%s'\n", m_xAst.arrlen(iNode) );
 	}
 
-	void _dbgOutContainer( PTContainer *pNode, int iLvl )
+	void _dbgOutContainer( AstIdx iNode, int iLvl )
 	{
 		_dbgTabs(iLvl); printf( "Children:\n" );
-		for( auto i = pNode->get_children().begin(); i != pNode->get_children().end(); ++i ) {
+		for( auto i = m_xAst.children(iNode).begin(); i != m_xAst.children(iNode).end(); ++i ) {
 			_dbgOut( *i, iLvl + 1 );
 		}
 	}
 
-	void _dbgOutMsgNBase( PTXMsgNBase *pNode, int iLvl )
+	void _dbgOutMsgNBase( AstIdx iNode, int iLvl )
 	{
-		_dbgTabs(iLvl); printf( "Name: '%s'\n", pNode->get_name().c_str() );
+		_dbgTabs(iLvl); printf( "Name: '%s'\n", m_xAst.name(iNode) );
 		_dbgTabs(iLvl); printf( "Inherits:\n" );
-		for( auto i = pNode->get_inherits().begin(); i != pNode->get_inherits().end(); ++i ) {
-			_dbgTabs(iLvl+1); printf( "'%s'\n", (*i).c_str() );
+		for( auto i = m_xAst.refs(iNode).begin(); i != m_xAst.refs(iNode).end(); ++i ) {
+			_dbgTabs(iLvl+1); printf( "'%s'\n", m_xAst.str(*i) );
 		}
-		_dbgOutContainer( pNode, iLvl );
+		_dbgOutContainer( iNode, iLvl );
 	}
 
-	void _dbgOutMessage( PTMessage *pNode, int iLvl )
+	void _dbgOutMessage( AstIdx iNode, int iLvl )
 	{
-		_dbgOutMsgNBase( pNode, iLvl );
+		_dbgOutMsgNBase( iNode, iLvl );
 	}
 
-	void _dbgOutBase( PTBase *pNode, int iLvl )
+	void _dbgOutBase( AstIdx iNode, int iLvl )
 	{
-		_dbgOutMsgNBase( pNode, iLvl );
+		_dbgOutMsgNBase( iNode, iLvl );
 	}
 
-	void _dbgOutList( PTList *pNode, int iLvl )
+	void _dbgOutList( AstIdx iNode, int iLvl )
 	{
-		_dbgOutMsgNBase( pNode, iLvl );
+		_dbgOutMsgNBase( iNode, iLvl );
 	}
 
-	void _dbgOutRoot( PTRoot *pNode, int iLvl )
+	void _dbgOutRoot( AstIdx iNode, int iLvl )
 	{
-		_dbgOutContainer( pNode, iLvl );
+		_dbgOutContainer( iNode, iLvl );
 	}
 
-	void _dbgOutNamespace( PTNamespace *pNode, int iLvl )
+	void _dbgOutNamespace( AstIdx iNode, int iLvl )
 	{
-		_dbgTabs(iLvl); printf( "Name: '%s'\n", pNode->get_name().c_str() );
+		_dbgTabs(iLvl); printf( "Name: '%s'\n", m_xAst.name(iNode) );
 
-		_dbgOutContainer( pNode, iLvl );
+		_dbgOutContainer( iNode, iLvl );
 	}
 
-	void _dbgOut( PTElement *pNode, int iLvl = 0 )
+	void _dbgOut( AstIdx iNode, int iLvl = 0 )
 	{
-		_dbgTabs(iLvl); printf( "['%s'\n", ePT_Names[pNode->type()] );
+		_dbgTabs(iLvl); printf( "['%s'\n", ePT_Names[m_xAst.type(iNode)] );
 		iLvl++;
 
-#define LAZYMAN(x) if( pNode->type() == ePT_##x ) { _dbgOut##x((PT##x*)pNode,iLvl); } 
+		switch( m_xAst.type(iNode) ) {
+#define LAZYMAN(x) case ePT_##x: _dbgOut##x(iNode,iLvl); break;
 		LAZYMAN(Root)
-		else LAZYMAN(Enum)
-		else LAZYMAN(Typedef)
-		else LAZYMAN(Namespace)
-		else LAZYMAN(Message)
-		else LAZYMAN(Base)
-		else LAZYMAN(List)
-		else LAZYMAN(Var)
+		LAZYMAN(Enum)
+		LAZYMAN(Typedef)
+		LAZYMAN(Namespace)
+		LAZYMAN(Message)
+		LAZYMAN(Base)
+		LAZYMAN(List)
+		LAZYMAN(Var)
 #undef LAZYMAN
+		default: break;
+		}
 
 		iLvl--;
 		_dbgTabs(iLvl); printf( "]\n" );
@@ -767,6 +588,6 @@ public:
 
 	void dbgOutput( )
 	{
-		_dbgOut( get_root() );
+		_dbgOut( AST_ROOT );
 	}
 };
\ No newline at end of file
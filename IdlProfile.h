@@ -0,0 +1,318 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <chrono>
+#include <new>
+
+// Heap use of the calling thread. The counters only move in a program
+//  that defines IDL_PROFILE_ALLOCS in exactly one translation unit before
+//  including this header, which replaces the global operator new/delete
+//  with versions that keep a size prefix on every block. IdlOutput
+//  reports its own buffer here as well, since it grows with realloc.
+struct SAllocCounters
+{
+	size_t iCount;
+	size_t iBytes;
+	size_t iLive;
+	size_t iPeak;
+
+	void alloc( size_t iSize )
+	{
+		iCount++;
+		iBytes += iSize;
+		iLive += iSize;
+		if( iLive > iPeak ) {
+			iPeak = iLive;
+		}
+	}
+
+	void release( size_t iSize )
+	{
+		iLive -= iSize < iLive ? iSize : iLive;
+	}
+
+	// Takes on heap use measured on threads that ran alongside this one,
+	//  given relative to where they started. Their peaks are assumed to
+	//  coincide, and land on top of what is live here now.
+	void absorb( const SAllocCounters& xOther )
+	{
+		if( iLive + xOther.iPeak > iPeak ) {
+			iPeak = iLive + xOther.iPeak;
+		}
+		iCount += xOther.iCount;
+		iBytes += xOther.iBytes;
+		iLive += xOther.iLive;
+	}
+
+	static SAllocCounters& local( )
+	{
+		static thread_local SAllocCounters xCounters = { 0, 0, 0, 0 };
+		return xCounters;
+	}
+};
+
+#define IDL_PROFILE_PHASES( PHASE ) \
+	PHASE( Lex, "lex" ) \
+	PHASE( Parse, "parse" ) \
+	PHASE( Resolve, "resolve" ) \
+	PHASE( Snapshot, "snapshot" ) \
+	PHASE( Generate, "generate" ) \
+	PHASE( GenMembers, "gen.members" ) \
+	PHASE( GenGetSet, "gen.getset" ) \
+	PHASE( GenSer, "gen.serialize" ) \
+	PHASE( GenUnser, "gen.unserialize" ) \
+	PHASE( GenViews, "gen.views" )
+
+#define IDL_PROFILE_PHASE_ENUM(x,s) ePhase_##x,
+enum ePhase
+{
+	IDL_PROFILE_PHASES( IDL_PROFILE_PHASE_ENUM )
+	ePhase_COUNT
+};
+#undef IDL_PROFILE_PHASE_ENUM
+
+struct SPhaseStats
+{
+	unsigned int iRuns;
+	double dMs;
+	size_t iAllocs;
+	size_t iBytes;
+	size_t iPeak;		// most live bytes above what was live when the phase began
+};
+
+// Per-phase wall time and heap use for one compilation, plus the sizes of
+//  what each phase produced. The gen.* phases are the generator's stages,
+//  summed over every message, and nest inside generate. When generation
+//  runs on several threads, their heap use is counted in generate too, but
+//  the gen.* times are summed over the threads and may exceed its time.
+class IdlProfile
+{
+protected:
+	SPhaseStats m_axPhases[ePhase_COUNT];
+
+	static const char* _phaseName( int iPhase )
+	{
+#define IDL_PROFILE_PHASE_NAME(x,s) s,
+		static const char *s_apcNames[] = {
+			IDL_PROFILE_PHASES( IDL_PROFILE_PHASE_NAME )
+		};
+#undef IDL_PROFILE_PHASE_NAME
+		return s_apcNames[iPhase];
+	}
+
+public:
+	size_t iTokens;
+	size_t iNodes;
+	size_t iMessages;
+	size_t iBases;
+	size_t iLines;
+
+	// Measures one run of a phase from construction to destruction. The
+	//  thread's peak is restored on the way out so an enclosing phase
+	//  still sees the high-water mark of the phases nested inside it.
+	class Scope
+	{
+	protected:
+		IdlProfile *m_pProfile;
+		ePhase m_iPhase;
+		std::chrono::steady_clock::time_point m_xStart;
+		SAllocCounters m_xStartAllocs;
+
+	public:
+		Scope( IdlProfile *pProfile, ePhase iPhase )
+			: m_pProfile(pProfile), m_iPhase(iPhase)
+		{
+			if( m_pProfile ) {
+				SAllocCounters& xAllocs = SAllocCounters::local( );
+				m_xStartAllocs = xAllocs;
+				xAllocs.iPeak = xAllocs.iLive;
+				m_xStart = std::chrono::steady_clock::now( );
+			}
+		}
+
+		~Scope( )
+		{
+			if( !m_pProfile ) {
+				return;
+			}
+
+			double dMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - m_xStart ).count( );
+			SAllocCounters& xAllocs = SAllocCounters::local( );
+			SPhaseStats& xPhase = m_pProfile->m_axPhases[m_iPhase];
+			size_t iPeak = xAllocs.iPeak - m_xStartAllocs.iLive;
+
+			xPhase.iRuns++;
+			xPhase.dMs += dMs;
+			xPhase.iAllocs += xAllocs.iCount - m_xStartAllocs.iCount;
+			xPhase.iBytes += xAllocs.iBytes - m_xStartAllocs.iBytes;
+			if( iPeak > xPhase.iPeak ) {
+				xPhase.iPeak = iPeak;
+			}
+
+			if( m_xStartAllocs.iPeak > xAllocs.iPeak ) {
+				xAllocs.iPeak = m_xStartAllocs.iPeak;
+			}
+		}
+
+	private:
+		Scope( const Scope& );
+		Scope& operator=( const Scope& );
+	};
+
+	IdlProfile( )
+	{
+		clear( );
+	}
+
+	void clear( )
+	{
+		for( int i = 0; i < ePhase_COUNT; ++i ) {
+			m_axPhases[i].iRuns = 0;
+			m_axPhases[i].dMs = 0;
+			m_axPhases[i].iAllocs = 0;
+			m_axPhases[i].iBytes = 0;
+			m_axPhases[i].iPeak = 0;
+		}
+		iTokens = 0;
+		iNodes = 0;
+		iMessages = 0;
+		iBases = 0;
+		iLines = 0;
+	}
+
+	// Adds the phases of a profile taken on another thread. Peaks are
+	//  kept per thread, so the larger one is kept rather than the sum.
+	void merge( const IdlProfile& xOther )
+	{
+		for( int i = 0; i < ePhase_COUNT; ++i ) {
+			const SPhaseStats& xFrom = xOther.m_axPhases[i];
+			SPhaseStats& xTo = m_axPhases[i];
+			xTo.iRuns += xFrom.iRuns;
+			xTo.dMs += xFrom.dMs;
+			xTo.iAllocs += xFrom.iAllocs;
+			xTo.iBytes += xFrom.iBytes;
+			if( xFrom.iPeak > xTo.iPeak ) {
+				xTo.iPeak = xFrom.iPeak;
+			}
+		}
+		iTokens += xOther.iTokens;
+		iNodes += xOther.iNodes;
+		iMessages += xOther.iMessages;
+		iBases += xOther.iBases;
+		iLines += xOther.iLines;
+	}
+
+	const SPhaseStats& phase( ePhase iPhase ) const { return m_axPhases[iPhase]; }
+
+	// One table per file; phases that never ran are left out
+	std::string text( const char *pcName ) const
+	{
+		std::string sOut;
+		char acLine[256];
+		sprintf( acLine, "%s: %u tokens, %u nodes, %u messages, %u bases, %u lines generated\n", pcName,
+			(unsigned)iTokens, (unsigned)iNodes, (unsigned)iMessages, (unsigned)iBases, (unsigned)iLines );
+		sOut += acLine;
+		sprintf( acLine, "  %-16s %10s %10s %12s %12s\n", "phase", "ms", "allocs", "alloc KB", "peak KB" );
+		sOut += acLine;
+		for( int i = 0; i < ePhase_COUNT; ++i ) {
+			const SPhaseStats& xPhase = m_axPhases[i];
+			if( xPhase.iRuns == 0 ) {
+				continue;
+			}
+			sprintf( acLine, "  %-16s %10.3f %10u %12.1f %12.1f\n", _phaseName(i), xPhase.dMs,
+				(unsigned)xPhase.iAllocs, xPhase.iBytes / 1024.0, xPhase.iPeak / 1024.0 );
+			sOut += acLine;
+		}
+		return sOut;
+	}
+
+	// One JSON object; pcName must not need escaping beyond '\' and '"'
+	std::string json( const char *pcName ) const
+	{
+		std::string sOut = "{\"file\":\"";
+		for( const char *p = pcName; *p; ++p ) {
+			if( *p == '\\' || *p == '"' ) {
+				sOut += '\\';
+			}
+			sOut += *p;
+		}
+
+		char acPart[256];
+		sprintf( acPart, "\",\"tokens\":%u,\"nodes\":%u,\"messages\":%u,\"bases\":%u,\"lines\":%u,\"phases\":{",
+			(unsigned)iTokens, (unsigned)iNodes, (unsigned)iMessages, (unsigned)iBases, (unsigned)iLines );
+		sOut += acPart;
+
+		bool bFirst = true;
+		for( int i = 0; i < ePhase_COUNT; ++i ) {
+			const SPhaseStats& xPhase = m_axPhases[i];
+			if( xPhase.iRuns == 0 ) {
+				continue;
+			}
+			sprintf( acPart, "%s\"%s\":{\"ms\":%.4f,\"allocs\":%u,\"bytes\":%u,\"peak_bytes\":%u}", bFirst ? "" : ",",
+				_phaseName(i), xPhase.dMs, (unsigned)xPhase.iAllocs, (unsigned)xPhase.iBytes, (unsigned)xPhase.iPeak );
+			sOut += acPart;
+			bFirst = false;
+		}
+		return sOut + "}}";
+	}
+};
+
+#ifdef IDL_PROFILE_ALLOCS
+// Each block carries its size in a prefix wide enough to keep the
+//  default new alignment.
+static const size_t IDL_ALLOC_PREFIX = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+static void* idlProfileAlloc( size_t iSize )
+{
+	char *pcBlock = (char*)malloc( iSize + IDL_ALLOC_PREFIX );
+	if( !pcBlock ) {
+		return nullptr;
+	}
+	*(size_t*)pcBlock = iSize;
+	SAllocCounters::local().alloc( iSize );
+	return pcBlock + IDL_ALLOC_PREFIX;
+}
+
+static void idlProfileFree( void *pBlock )
+{
+	if( !pBlock ) {
+		return;
+	}
+	char *pcBlock = (char*)pBlock - IDL_ALLOC_PREFIX;
+	SAllocCounters::local().release( *(size_t*)pcBlock );
+	::free( pcBlock );
+}
+
+void* operator new( size_t iSize )
+{
+	void *pBlock = idlProfileAlloc( iSize );
+	if( !pBlock ) {
+		throw std::bad_alloc( );
+	}
+	return pBlock;
+}
+
+void* operator new[]( size_t iSize )
+{
+	return operator new( iSize );
+}
+
+void* operator new( size_t iSize, const std::nothrow_t& ) noexcept
+{
+	return idlProfileAlloc( iSize );
+}
+
+void* operator new[]( size_t iSize, const std::nothrow_t& ) noexcept
+{
+	return idlProfileAlloc( iSize );
+}
+
+void operator delete( void *pBlock ) noexcept { idlProfileFree( pBlock ); }
+void operator delete[]( void *pBlock ) noexcept { idlProfileFree( pBlock ); }
+void operator delete( void *pBlock, size_t ) noexcept { idlProfileFree( pBlock ); }
+void operator delete[]( void *pBlock, size_t ) noexcept { idlProfileFree( pBlock ); }
+void operator delete( void *pBlock, const std::nothrow_t& ) noexcept { idlProfileFree( pBlock ); }
+void operator delete[]( void *pBlock, const std::nothrow_t& ) noexcept { idlProfileFree( pBlock ); }
+#endif
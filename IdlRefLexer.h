@@ -0,0 +1,281 @@
+#pragma once
+#pragma warning( disable: 4996 )
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "IdlLexer.h"
+
+// The original byte-at-a-time lexer, kept as the reference the current
+//  one is checked against. Only its input moved from a FILE* to a byte
+//  range, with _getc(), _ungetc() and isEof() standing in for fgetc(),
+//  fseek( -1 ) and feof(), and the EOF token now has a line number. Every
+//  quirk of the original, such as dropping a '\r' wherever it appears,
+//  is kept.
+struct SRefToken
+{
+	int iLineNum;
+	eTok iType;
+	int iValue;
+	std::string sText;
+
+	SRefToken( ) : iLineNum(0), iType(eTok_UNKNOWN), iValue(0) { }
+};
+
+class IdlRefLexer
+{
+protected:
+	std::vector<SRefToken> m_asPeeks;
+	const char *m_pcCur;
+	const char *m_pcEnd;
+	bool m_bEof;
+	int m_iLineNum;
+
+	bool isEof( )
+	{
+		return m_bEof;
+	}
+
+	int _getc( )
+	{
+		if( m_pcCur >= m_pcEnd ) {
+			m_bEof = true;
+			return EOF;
+		}
+		return (unsigned char)*m_pcCur++;
+	}
+
+	void _ungetc( )
+	{
+		m_pcCur--;
+	}
+
+	static bool isEndOfLine( char cValue ) {
+		return cValue == '\n';
+	}
+
+	static bool isWhitespace( char cValue ) {
+		return cValue == '\r' || cValue == '\n' || cValue == '\t' || cValue == ' ';
+	}
+
+	static bool isNonLiteral( char cValue ) {
+		return cValue == '{' || cValue == '}' || cValue == '[' || cValue == ']' || cValue == ';' || cValue == ':' || cValue == ',' || cValue == '/';
+	}
+
+	static eTok getNonLiteralType( char cValue ) {
+		if( cValue == '{' ) {
+			return eTok_BRACE_OPEN;
+		} else if( cValue == '}' ) {
+			return eTok_BRACE_CLOSE;
+		} else if( cValue == '[' ) {
+			return eTok_ARR_OPEN;
+		} else if( cValue == ']' ) {
+			return eTok_ARR_CLOSE;
+		} else if( cValue == ',' ) {
+			return eTok_COMMA;
+		} else if( cValue == ':' ) {
+			return eTok_SEPERATOR;
+		} else if( cValue == ';' ) {
+			return eTok_TERMINATOR;
+		}
+		return eTok_UNKNOWN;
+	}
+
+	SRefToken _readToken( )
+	{
+		bool bInComment = false;
+		bool bTokenStarted = false;
+		SRefToken xToken;
+
+		while( !isEof() ) {
+			int cValue = _getc( );
+			if( cValue == EOF ) continue;
+
+			// Update line number info
+			if( cValue == '\n' ) {
+				m_iLineNum++;
+			}
+
+			// +++ Ignore Windows Fail Newlines
+			if( cValue == '\r' ) continue;
+			// ---
+
+			// +++ Handle Comments
+			if( !bInComment ) {
+				if( cValue == '/' ) {
+					char cValue2 = _getc( );
+					if( cValue2 == '/' ) {
+						bInComment = true;
+						continue;
+					} else {
+						throw LexException( m_iLineNum, "unexpected '/' literal" );
+					}
+				}
+			} else {
+				if( isEndOfLine(cValue) ) {
+					bInComment = false;
+				} else {
+					continue;
+				}
+			}
+			// --- Handle Comments
+
+			// +++ Don't Lex Whitespace +++
+			if( bTokenStarted ) {
+				if( isWhitespace(cValue) ) {
+					break;
+				} else if( isNonLiteral(cValue) ) {
+					_ungetc( );
+					break;
+				}
+			} else {
+				if( isWhitespace(cValue) ) {
+					continue;
+				} else {
+					bTokenStarted = true;
+					xToken.iLineNum = m_iLineNum;
+				}
+			}
+			// --- Don't Lex Whitespace ---
+
+			if( isNonLiteral(cValue) ) {
+				xToken.iType = getNonLiteralType( cValue );
+				xToken.sText.push_back( cValue );
+				return xToken;
+			}
+
+			xToken.iType = eTok_LITERAL;
+			xToken.sText.push_back( cValue );
+		}
+
+		if( isEof() && xToken.sText.size() == 0 ) {
+			xToken.iType = eTok_EOF;
+			xToken.iLineNum = m_iLineNum;
+		}
+
+		if( xToken.iType == eTok_UNKNOWN ) {
+			throw LexException( m_iLineNum, "bad token" );
+		}
+
+		eTok iNewType = eTok_UNKNOWN;
+		if( xToken.sText == "message" ) {
+			iNewType = eTok_KEY_MESSAGE;
+		} else if( xToken.sText == "base" ) {
+			iNewType = eTok_KEY_BASE;
+		} else if( xToken.sText == "enum" ) {
+			iNewType = eTok_KEY_ENUM;
+		} else if( xToken.sText == "namespace" ) {
+			iNewType = eTok_KEY_NAMESPACE;
+		} else if( xToken.sText == "@type" ) {
+			iNewType = eTok_KEY_TYPEDEF;
+		} else if( xToken.sText == "list" ) {
+			iNewType = eTok_KEY_LIST;
+		}
+
+		if( iNewType != eTok_UNKNOWN ) {
+			if( xToken.iType != eTok_LITERAL ) {
+				throw LexException( m_iLineNum, "invalid use of language keyword" );
+			}
+			xToken.iType = iNewType;
+		}
+
+		return xToken;
+	}
+
+public:
+	IdlRefLexer( const char *pcBegin, const char *pcEnd )
+		: m_pcCur(pcBegin), m_pcEnd(pcEnd), m_bEof(false), m_iLineNum(1)
+	{
+	}
+
+	SRefToken readToken( )
+	{
+		if( m_asPeeks.size() >= 1 ) {
+			SRefToken xToken = m_asPeeks.back( );
+			m_asPeeks.pop_back( );
+			return xToken;
+		}
+
+		return _readToken( );
+	}
+
+	SRefToken peekToken( )
+	{
+		SRefToken xToken = readToken( );
+		m_asPeeks.push_back( xToken );
+		return xToken;
+	}
+
+	// Lexes pInput with this lexer and with both IdlLexer paths, readToken()
+	//  and tokenize(), and compares every token's type, text and line, and
+	//  where lexing failed, the line it failed on. Returns false and
+	//  describes the first difference in sMismatch.
+	static bool verify( const IdlInput *pInput, std::string& sMismatch )
+	{
+		std::vector<SRefToken> vRef;
+		int iRefError = 0;
+		try {
+			IdlRefLexer xRef( pInput->begin(), pInput->end() );
+			do {
+				vRef.push_back( xRef.readToken() );
+			} while( vRef.back().iType != eTok_EOF );
+		} catch( LexException& e ) {
+			iRefError = e.line_num( );
+		}
+
+		IdlSymbols xSymbols;
+		std::vector<SToken> vStream;
+		int iStreamError = 0;
+		try {
+			IdlLexer xLexer( pInput, &xSymbols );
+			do {
+				vStream.push_back( xLexer.readToken() );
+			} while( vStream.back().iType != eTok_EOF );
+		} catch( LexException& e ) {
+			iStreamError = e.line_num( );
+		}
+
+		IdlTokenList xTokens;
+		std::vector<SToken> vList;
+		int iListError = 0;
+		try {
+			IdlLexer xLexer( pInput, &xSymbols );
+			xLexer.tokenize( xTokens );
+		} catch( LexException& e ) {
+			iListError = e.line_num( );
+		}
+		for( size_t i = 0; i < xTokens.size(); ++i ) {
+			vList.push_back( xTokens.get(i) );
+		}
+
+		return _compare( pInput, vRef, iRefError, vStream, iStreamError, "readToken", sMismatch )
+			&& _compare( pInput, vRef, iRefError, vList, iListError, "tokenize", sMismatch );
+	}
+
+protected:
+	static bool _compare( const IdlInput *pInput, const std::vector<SRefToken>& vRef, int iRefError,
+		const std::vector<SToken>& vNew, int iNewError, const char *pcPath, std::string& sMismatch )
+	{
+		char acBuf[512];
+		for( size_t i = 0; i < vRef.size() && i < vNew.size(); ++i ) {
+			const SRefToken& xRef = vRef[i];
+			const SToken& xNew = vNew[i];
+			int iNewLine = pInput->line_num( xNew.iOffset );
+			if( xRef.iType != xNew.iType || xRef.sText != xNew.sText || xRef.iLineNum != iNewLine ) {
+				snprintf( acBuf, sizeof(acBuf), "%s token %u: reference %s '%.*s' line %d, got %s '%.*s' line %d", pcPath, (unsigned)i,
+					eTok_Names[xRef.iType], (int)xRef.sText.size(), xRef.sText.data(), xRef.iLineNum,
+					eTok_Names[xNew.iType], (int)xNew.sText.size(), xNew.sText.data(), iNewLine );
+				sMismatch = acBuf;
+				return false;
+			}
+		}
+
+		if( vRef.size() != vNew.size() || iRefError != iNewError ) {
+			snprintf( acBuf, sizeof(acBuf), "%s: reference lexed %u tokens (error on line %d), got %u (error on line %d)", pcPath,
+				(unsigned)vRef.size(), iRefError, (unsigned)vNew.size(), iNewError );
+			sMismatch = acBuf;
+			return false;
+		}
+		return true;
+	}
+};
@@ -2,19 +2,21 @@
 
 #include <list>
 #include "IdlParser.h"
+#include "IdlScopes.h"
+#include "IdlLayout.h"
 
 class ResolveException : public std::exception
 {
 protected:
-	PTElement *m_pNode;
+	AstIdx m_iNode;
 
 public:
-	ResolveException( PTElement *pNode, const char* pcText )
-		: std::exception( pcText ), m_pNode(pNode)
+	ResolveException( AstIdx iNode, const char* pcText )
+		: std::exception( pcText ), m_iNode(iNode)
 	{
 	}
 
-	PTElement *node() const { return m_pNode; }
+	AstIdx node() const { return m_iNode; }
 };
 
 enum eFlags
@@ -39,188 +41,301 @@ static const int FLAGS_LIST = eFlag_AllowVar | eFlag_AllowList;
 class IdlResolver
 {
 protected:
-	PTContainer *m_pRoot;
-	PTElement *m_pCurElem;
+	// Names reachable from a Message/Base/List through its inherits and
+	//  nested lists. vBases holds only the names that were reached through
+	//  an inherit, since those are the ones that may not repeat.
+	struct SClosure
+	{
+		std::vector<SymId> vAll;
+		std::vector<SymId> vBases;
+	};
+
+	enum eClosureState
+	{
+		eClosure_None = 0,
+		eClosure_Active,
+		eClosure_Done
+	};
+
+	IdlAst *m_pAst;
+	IdlScopes m_xScopes;
+	IdlLayouts m_xLayouts;
+
+	std::vector<unsigned char> m_viState;
+	std::vector<SClosure> m_vxClosures;
+	std::vector<bool> m_vbAll;
+	std::vector<bool> m_vbBases;
 
 public:
-	IdlResolver( PTContainer *pRoot )
-		: m_pRoot(pRoot)
+	IdlResolver( IdlAst *pAst )
+		: m_pAst(pAst)
+	{
+		m_xScopes.build( pAst );
+	}
+
+	AstIdx findBaseNode( SymId iName, AstIdx iStart = AST_ROOT )
+	{
+		return m_xScopes.find( iName, iStart );
+	}
+
+	void _mark( SClosure& xClosure, SymId iName, bool bBase )
+	{
+		if( !m_vbAll[iName] ) {
+			m_vbAll[iName] = true;
+			xClosure.vAll.push_back( iName );
+		}
+		if( bBase && !m_vbBases[iName] ) {
+			m_vbBases[iName] = true;
+			xClosure.vBases.push_back( iName );
+		}
+	}
+
+	void _multipleError( AstIdx iStartNode, SymId iName )
 	{
+		std::string sErrStr = std::string("object has multiple inheritances of base '") + m_pAst->str(iName) + "'";
+		throw ResolveException( iStartNode, sErrStr.c_str() );
 	}
 
-	PTXMsgNBase* findBaseNode( const std::string& sName, PTContainer *pStart = nullptr )
+	// Folds a part's closure into the one being built for iNode. iBase is
+	//  the inherited name that led to the part, or SYM_NONE for a list.
+	void _inheritMerge( AstIdx iStartNode, AstIdx iNode, SClosure& xClosure, const SClosure& xPart, SymId iBase )
 	{
-		if( pStart == nullptr ) pStart = m_pRoot;
+		SymId iName = m_pAst->name_id( iNode );
+		if( iBase == iName || _contains(xPart.vBases, iName) ) {
+			throw ResolveException( iStartNode, "object has a circular inheritance" );
+		}
 
-		for( auto i = pStart->get_children().begin(); i != pStart->get_children().end(); ++i ) {
-			if( (*i)->type() != ePT_Base && (*i)->type() != ePT_List ) {
-				continue;
+		if( iBase != SYM_NONE && m_vbAll[iBase] ) {
+			_multipleError( iStartNode, iBase );
+		}
+		for( auto i = xPart.vBases.begin(); i != xPart.vBases.end(); ++i ) {
+			if( m_vbAll[*i] ) {
+				_multipleError( iStartNode, *i );
 			}
-			if( (*i)->name() == sName ) {
-				return (PTXMsgNBase*)(*i);
+		}
+		for( auto i = xPart.vAll.begin(); i != xPart.vAll.end(); ++i ) {
+			if( m_vbBases[*i] ) {
+				_multipleError( iStartNode, *i );
 			}
 		}
 
-		PTContainer *pParent = pStart->get_parent();
-		if( pParent ) {
-			return findBaseNode( sName, pParent );
+		if( iBase != SYM_NONE ) {
+			_mark( xClosure, iBase, true );
+		}
+		for( auto i = xPart.vBases.begin(); i != xPart.vBases.end(); ++i ) {
+			_mark( xClosure, *i, true );
+		}
+		for( auto i = xPart.vAll.begin(); i != xPart.vAll.end(); ++i ) {
+			_mark( xClosure, *i, false );
 		}
-		return nullptr;
 	}
 
-	void _inheritFollow( PTXMsgNBase *pStartNode, PTXMsgNBase *pNode, std::vector<std::string>& vAllInherit, std::vector<std::string> vInherit )
+	static bool _contains( const std::vector<SymId>& vNames, SymId iName )
 	{
-		vAllInherit.push_back( pNode->name() );
-		vInherit.push_back( pNode->name() );
+		for( auto i = vNames.begin(); i != vNames.end(); ++i ) {
+			if( *i == iName ) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-		for( auto i = pNode->get_children().begin(); i != pNode->get_children().end(); ++i )
-		{
-			if( (*i)->type() == ePT_List ) {
-				_inheritFollow( pStartNode, (PTList*)(*i), vAllInherit, vInherit );
+	// Computes iNode's closure after those of its lists and bases, so each
+	//  closure is built exactly once in topological order and then shared
+	//  by every node that inherits it.
+	const SClosure& _inheritClosure( AstIdx iStartNode, AstIdx iNode )
+	{
+		if( m_viState[iNode] == eClosure_Done ) {
+			return m_vxClosures[iNode];
+		}
+		if( m_viState[iNode] == eClosure_Active ) {
+			throw ResolveException( iStartNode, "object has a circular inheritance" );
+		}
+		m_viState[iNode] = eClosure_Active;
+
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			if( m_pAst->type(*i) == ePT_List ) {
+				_inheritClosure( iStartNode, *i );
+			}
+		}
+
+		auto xInherits = m_pAst->refs( iNode );
+		for( size_t i = 0; i < xInherits.size(); ++i ) {
+			AstIdx iElem = findBaseNode( xInherits[i], iNode );
+			m_pAst->set_ref_target( iNode, i, iElem );
+			if( iElem != AST_NONE ) {
+				_inheritClosure( iStartNode, iElem );
 			}
 		}
 
-		for( auto i = pNode->get_inherits().begin(); i != pNode->get_inherits().end(); ++i )
-		{
-			// Check for circle-inheritance
-			for( auto j = vInherit.begin(); j != vInherit.end(); ++j ) {
-				if( (*i) == (*j) ) {
-					throw ResolveException( pStartNode, "object has a circular inheritance" );
-				}
+		SClosure xClosure;
+		_mark( xClosure, m_pAst->name_id(iNode), false );
+
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+			if( m_pAst->type(*i) == ePT_List ) {
+				_inheritMerge( iStartNode, iNode, xClosure, m_vxClosures[*i], SYM_NONE );
 			}
+		}
 
-			// Check for multi-inheritance
-			for( auto j = vAllInherit.begin(); j != vAllInherit.end(); ++j ) {
-				if( (*i) == (*j) ) {
-					std::string sErrStr = "object has multiple inheritances of base '" + (*i) + "'";
-					throw ResolveException( pStartNode, sErrStr.c_str() );
-				}
-			}			
+		auto xBases = m_pAst->ref_targets( iNode );
+		for( size_t i = 0; i < xBases.size(); ++i ) {
+			if( xBases[i] != AST_NONE ) {
+				_inheritMerge( iStartNode, iNode, xClosure, m_vxClosures[xBases[i]], xInherits[i] );
+			}
+		}
 
-			PTXMsgNBase *pElem = findBaseNode( *i, pNode );
-			if( pElem ) {
-				_inheritFollow( pStartNode, pElem, vAllInherit, vInherit );
-			}			
+		// Leave the bitsets clear for the next closure
+		for( auto i = xClosure.vAll.begin(); i != xClosure.vAll.end(); ++i ) {
+			m_vbAll[*i] = false;
+		}
+		for( auto i = xClosure.vBases.begin(); i != xClosure.vBases.end(); ++i ) {
+			m_vbBases[*i] = false;
 		}
+
+		m_vxClosures[iNode].vAll.swap( xClosure.vAll );
+		m_vxClosures[iNode].vBases.swap( xClosure.vBases );
+		m_viState[iNode] = eClosure_Done;
+		return m_vxClosures[iNode];
 	}
 
-	void _inheritCheck( PTXMsgNBase *pNode )
+	void _inheritCheck( AstIdx iNode )
 	{
-		for( auto i = pNode->get_inherits().begin(); i != pNode->get_inherits().end(); ++i ) {
-			PTXMsgNBase *pElem = findBaseNode( *i, pNode );
-			if( !pElem ) {
-				std::string sErrStr = "reference to non-existent base '" + (*i) + "'";
-				throw ResolveException( pNode, sErrStr.c_str() );
+		auto xInherits = m_pAst->refs( iNode );
+		for( size_t i = 0; i < xInherits.size(); ++i ) {
+			AstIdx iElem = findBaseNode( xInherits[i], iNode );
+			if( iElem == AST_NONE ) {
+				std::string sErrStr = std::string("reference to non-existent base '") + m_pAst->str(xInherits[i]) + "'";
+				throw ResolveException( iNode, sErrStr.c_str() );
 			}
+			m_pAst->set_ref_target( iNode, i, iElem );
 		}
 
-		std::vector<std::string> vInherit;
-		//vInherit.push_back( pNode->name() );
-		std::vector<std::string> vAllInherit;
-		//vAllInherit.push_back( pNode->name() );
-		_inheritFollow( pNode, pNode, vAllInherit, vInherit );
+		_inheritClosure( iNode, iNode );
 	}
 
-	void _chkMsgNBase( PTXMsgNBase *pNode, eFlag iFlags )
+	void _chkMsgNBase( AstIdx iNode, eFlag iFlags )
 	{
-		_inheritCheck( pNode );
+		_inheritCheck( iNode );
 
-		_chkContainer( pNode, iFlags );
+		_chkContainer( iNode, iFlags );
 	}
 
-	void _chkContainer( PTContainer *pNode, eFlag iFlags )
+	void _chkContainer( AstIdx iNode, eFlag iFlags )
 	{
-		for( auto i = pNode->get_children().begin(); i != pNode->get_children().end(); ++i ) {
+		auto xChildren = m_pAst->children( iNode );
+		for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
 			_chk( *i, iFlags );
 		}
 	}
 
-	void _chkRoot( PTRoot *pNode, eFlag iFlags )
+	void _chkRoot( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowRoot) ) {
-			throw ResolveException( pNode, "invalid root location" );
+			throw ResolveException( iNode, "invalid root location" );
 		}
 
-		_chkContainer( pNode, FLAGS_ROOT );
+		_chkContainer( iNode, FLAGS_ROOT );
 	}
 
-	void _chkTypedef( PTTypedef *pNode, eFlag iFlags )
+	void _chkTypedef( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowTypedef) ) {
-			throw ResolveException( pNode, "invalid typedef location" );
+			throw ResolveException( iNode, "invalid typedef location" );
 		}
 	}
 
 	
-	void _chkNamespace( PTNamespace *pNode, eFlag iFlags )
+	void _chkNamespace( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowNamespace) ) {
-			throw ResolveException( pNode, "invalid namespace location" );
+			throw ResolveException( iNode, "invalid namespace location" );
 		}
 
-		_chkContainer( pNode, FLAGS_NAMESPACE );
+		_chkContainer( iNode, FLAGS_NAMESPACE );
 	}
 
-	void _chkMessage( PTMessage *pNode, eFlag iFlags )
+	void _chkMessage( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowMessage) ) {
-			throw ResolveException( pNode, "invalid message location" );
+			throw ResolveException( iNode, "invalid message location" );
 		}
 
-		_chkMsgNBase( pNode, FLAGS_MESSAGE );
+		_chkMsgNBase( iNode, FLAGS_MESSAGE );
 	}
 
-	void _chkBase( PTBase *pNode, eFlag iFlags )
+	void _chkBase( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowBase) ) {
-			throw ResolveException( pNode, "invalid base location" );
+			throw ResolveException( iNode, "invalid base location" );
 		}
 
-		_chkMsgNBase( pNode, FLAGS_BASE );
+		_chkMsgNBase( iNode, FLAGS_BASE );
 	}
 
-	void _chkList( PTList *pNode, eFlag iFlags )
+	void _chkList( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowList) ) {
-			throw ResolveException( pNode, "invalid list location" );
+			throw ResolveException( iNode, "invalid list location" );
 		}
 
-		_chkMsgNBase( pNode, FLAGS_LIST );
+		_chkMsgNBase( iNode, FLAGS_LIST );
 	}
 
-	void _chkVar( PTVar *pNode, eFlag iFlags )
+	void _chkVar( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowVar) ) {
-			throw ResolveException( pNode, "invalid var location" );
+			throw ResolveException( iNode, "invalid var location" );
 		}
 	}
 
-	void _chkEnum( PTEnum *pNode, eFlag iFlags )
+	void _chkEnum( AstIdx iNode, eFlag iFlags )
 	{
 		if( !(iFlags & eFlag_AllowEnum) ) {
-			throw ResolveException( pNode, "invalid enum location" );
+			throw ResolveException( iNode, "invalid enum location" );
 		}
 	}
 
-	void _chk( PTElement *pNode, eFlag iFlags )
+	void _chk( AstIdx iNode, eFlag iFlags )
 	{
-#define LAZYMAN(x) if( pNode->type() == ePT_##x ) { _chk##x((PT##x*)pNode,iFlags); } 
+		switch( m_pAst->type(iNode) ) {
+#define LAZYMAN(x) case ePT_##x: _chk##x(iNode,iFlags); break;
 		LAZYMAN(Root)
-		else LAZYMAN(Enum)
-		else LAZYMAN(Typedef)
-		else LAZYMAN(Namespace)
-		else LAZYMAN(Message)
-		else LAZYMAN(Base)
-		else LAZYMAN(List)
-		else LAZYMAN(Var)
+		LAZYMAN(Enum)
+		LAZYMAN(Typedef)
+		LAZYMAN(Namespace)
+		LAZYMAN(Message)
+		LAZYMAN(Base)
+		LAZYMAN(List)
+		LAZYMAN(Var)
 #undef LAZYMAN
-
+		default: break;
+		}
 	}
 
 	bool validate( )
 	{
-		_chk( m_pRoot, eFlag_AllowRoot );
+		m_viState.assign( m_pAst->node_cnt(), eClosure_None );
+		m_vxClosures.assign( m_pAst->node_cnt(), SClosure() );
+		m_vbAll.assign( m_pAst->symbols()->size(), false );
+		m_vbBases.assign( m_pAst->symbols()->size(), false );
+
+		_chk( AST_ROOT, eFlag_AllowRoot );
+
+		m_xLayouts.build( m_pAst );
 		return true;
 	}
 
+	// Valid once validate() has succeeded
+	const IdlLayouts& get_layouts( ) const
+	{
+		return m_xLayouts;
+	}
+
+	// Hands the layouts to a caller that outlives the resolver
+	void take_layouts( IdlLayouts& xOut )
+	{
+		xOut.swap( m_xLayouts );
+	}
+
 };
\ No newline at end of file
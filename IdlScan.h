@@ -0,0 +1,148 @@
+#pragma once
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IDLSCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define IDLSCAN_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum eCharClass
+{
+	eCC_Literal = 0,
+	eCC_Whitespace = 1,
+	eCC_Delimiter = 2
+};
+
+// Character classification for the lexer. Whitespace and delimiter runs are
+//  located a whole vector at a time (AVX2: 32 bytes, SSE2: 16 bytes) by
+//  building a bitmask per class and jumping to its first set bit. The tail
+//  of the input, and targets without SSE2, go through a 256-entry table.
+class IdlScan
+{
+protected:
+	struct SClassTable
+	{
+		unsigned char acClass[256];
+
+		SClassTable( )
+		{
+			memset( acClass, eCC_Literal, sizeof(acClass) );
+			const char *pcWhitespace = " \t\r\n";
+			const char *pcDelimiters = "{}[];:,/";
+			for( const char *p = pcWhitespace; *p; ++p ) acClass[(unsigned char)*p] = eCC_Whitespace;
+			for( const char *p = pcDelimiters; *p; ++p ) acClass[(unsigned char)*p] = eCC_Delimiter;
+		}
+	};
+
+	static const unsigned char* _table( )
+	{
+		static const SClassTable s_xTable;
+		return s_xTable.acClass;
+	}
+
+	static unsigned int _firstBit( unsigned int uMask )
+	{
+#ifdef _MSC_VER
+		unsigned long uIdx;
+		_BitScanForward( &uIdx, uMask );
+		return uIdx;
+#else
+		return __builtin_ctz( uMask );
+#endif
+	}
+
+#if defined(IDLSCAN_AVX2)
+	static const int BLOCK = 32;
+	typedef __m256i vec_t;
+
+	static vec_t _load( const char *p ) { return _mm256_loadu_si256( (const __m256i*)p ); }
+	static vec_t _eq( vec_t v, char c ) { return _mm256_cmpeq_epi8( v, _mm256_set1_epi8(c) ); }
+	static vec_t _or( vec_t a, vec_t b ) { return _mm256_or_si256( a, b ); }
+	static unsigned int _mask( vec_t v ) { return (unsigned int)_mm256_movemask_epi8( v ); }
+	static const unsigned int FULL_MASK = 0xFFFFFFFFu;
+#elif defined(IDLSCAN_SSE2)
+	static const int BLOCK = 16;
+	typedef __m128i vec_t;
+
+	static vec_t _load( const char *p ) { return _mm_loadu_si128( (const __m128i*)p ); }
+	static vec_t _eq( vec_t v, char c ) { return _mm_cmpeq_epi8( v, _mm_set1_epi8(c) ); }
+	static vec_t _or( vec_t a, vec_t b ) { return _mm_or_si128( a, b ); }
+	static unsigned int _mask( vec_t v ) { return (unsigned int)_mm_movemask_epi8( v ); }
+	static const unsigned int FULL_MASK = 0xFFFFu;
+#endif
+
+#if defined(IDLSCAN_AVX2) || defined(IDLSCAN_SSE2)
+	static vec_t _whitespace( vec_t v )
+	{
+		return _or( _or( _eq(v,' '), _eq(v,'\t') ), _or( _eq(v,'\r'), _eq(v,'\n') ) );
+	}
+
+	static vec_t _delimiters( vec_t v )
+	{
+		vec_t a = _or( _or( _eq(v,'{'), _eq(v,'}') ), _or( _eq(v,'['), _eq(v,']') ) );
+		vec_t b = _or( _or( _eq(v,';'), _eq(v,':') ), _or( _eq(v,','), _eq(v,'/') ) );
+		return _or( a, b );
+	}
+#endif
+
+public:
+	static eCharClass classify( char cValue )
+	{
+		return (eCharClass)_table()[(unsigned char)cValue];
+	}
+
+	// Returns the first byte in [pcCur,pcEnd) that is not whitespace.
+	static const char* skip_whitespace( const char *pcCur, const char *pcEnd )
+	{
+#if defined(IDLSCAN_AVX2) || defined(IDLSCAN_SSE2)
+		while( pcEnd - pcCur >= BLOCK ) {
+			unsigned int uMask = ~_mask( _whitespace( _load(pcCur) ) ) & FULL_MASK;
+			if( uMask ) {
+				return pcCur + _firstBit( uMask );
+			}
+			pcCur += BLOCK;
+		}
+#endif
+		const unsigned char *pcTable = _table( );
+		while( pcCur < pcEnd && pcTable[(unsigned char)*pcCur] == eCC_Whitespace ) {
+			++pcCur;
+		}
+		return pcCur;
+	}
+
+	// Returns the first byte in [pcCur,pcEnd) that ends a literal, which is
+	//  any whitespace or delimiter.
+	static const char* find_literal_end( const char *pcCur, const char *pcEnd )
+	{
+#if defined(IDLSCAN_AVX2) || defined(IDLSCAN_SSE2)
+		while( pcEnd - pcCur >= BLOCK ) {
+			vec_t v = _load( pcCur );
+			unsigned int uMask = _mask( _or( _whitespace(v), _delimiters(v) ) );
+			if( uMask ) {
+				return pcCur + _firstBit( uMask );
+			}
+			pcCur += BLOCK;
+		}
+#endif
+		const unsigned char *pcTable = _table( );
+		while( pcCur < pcEnd && pcTable[(unsigned char)*pcCur] == eCC_Literal ) {
+			++pcCur;
+		}
+		return pcCur;
+	}
+
+	// Returns the first newline in [pcCur,pcEnd), or pcEnd.
+	static const char* find_newline( const char *pcCur, const char *pcEnd )
+	{
+		const char *pcFound = (const char*)memchr( pcCur, '\n', pcEnd - pcCur );
+		return pcFound ? pcFound : pcEnd;
+	}
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include "IdlAst.h"
+
+// Name index over every container scope of an IdlAst, built once after
+//  parsing. Each Base and List is entered under its (parent scope, name)
+//  pair in a single open-addressed table, so resolving a name from some
+//  scope costs one probe per enclosing scope instead of a scan of every
+//  sibling at every level.
+class IdlScopes
+{
+protected:
+	struct SEntry
+	{
+		AstIdx iScope;
+		SymId iName;
+		AstIdx iNode;
+	};
+
+	const IdlAst *m_pAst;
+	std::vector<SEntry> m_vTable;
+
+	static size_t _hash( AstIdx iScope, SymId iName )
+	{
+		unsigned int uHash = ( iScope * 0x9E3779B1u ) ^ ( iName * 0x85EBCA6Bu );
+		return uHash ^ ( uHash >> 15 );
+	}
+
+	size_t _slot( AstIdx iScope, SymId iName ) const
+	{
+		size_t iMask = m_vTable.size( ) - 1;
+		size_t iSlot = _hash( iScope, iName ) & iMask;
+		while( m_vTable[iSlot].iScope != AST_NONE ) {
+			if( m_vTable[iSlot].iScope == iScope && m_vTable[iSlot].iName == iName ) {
+				break;
+			}
+			iSlot = ( iSlot + 1 ) & iMask;
+		}
+		return iSlot;
+	}
+
+public:
+	IdlScopes( )
+		: m_pAst(nullptr)
+	{
+	}
+
+	void build( const IdlAst *pAst )
+	{
+		m_pAst = pAst;
+
+		size_t iCount = 0;
+		for( AstIdx i = 0; i < pAst->node_cnt(); ++i ) {
+			if( pAst->type(i) == ePT_Base || pAst->type(i) == ePT_List ) {
+				iCount++;
+			}
+		}
+
+		size_t iSize = 16;
+		while( iSize < iCount * 2 ) {
+			iSize *= 2;
+		}
+
+		SEntry xEmpty = { AST_NONE, SYM_EMPTY, AST_NONE };
+		m_vTable.assign( iSize, xEmpty );
+
+		// Nodes are numbered in source order, so the first declaration
+		//  of a name within a scope is the one that is kept
+		for( AstIdx i = 0; i < pAst->node_cnt(); ++i ) {
+			if( pAst->type(i) != ePT_Base && pAst->type(i) != ePT_List ) {
+				continue;
+			}
+
+			SEntry& xEntry = m_vTable[_slot( pAst->parent(i), pAst->name_id(i) )];
+			if( xEntry.iScope == AST_NONE ) {
+				xEntry.iScope = pAst->parent( i );
+				xEntry.iName = pAst->name_id( i );
+				xEntry.iNode = i;
+			}
+		}
+	}
+
+	// Base or List declared directly inside iScope, or AST_NONE
+	AstIdx find_local( AstIdx iScope, SymId iName ) const
+	{
+		const SEntry& xEntry = m_vTable[_slot( iScope, iName )];
+		return xEntry.iScope != AST_NONE ? xEntry.iNode : AST_NONE;
+	}
+
+	// Nearest Base or List visible from iStart, searching outwards
+	AstIdx find( SymId iName, AstIdx iStart ) const
+	{
+		for( AstIdx iScope = iStart; iScope != AST_NONE; iScope = m_pAst->parent(iScope) ) {
+			AstIdx iNode = find_local( iScope, iName );
+			if( iNode != AST_NONE ) {
+				return iNode;
+			}
+		}
+		return AST_NONE;
+	}
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <string.h>
+#include "IdlAst.h"
+#include "IdlSymbols.h"
+#include "IdlInput.h"
+#include "IdlOutput.h"
+
+// Binary image of a validated IdlAst and the IdlSymbols it names, so an
+//  unchanged schema can be reloaded without lexing, parsing or resolving.
+//  The file is the header below followed by these arrays, packed:
+//    SAstNode  nodes[iNodeCnt]
+//    AstIdx    children[iChildCnt]
+//    SymId     refs[iRefCnt]
+//    AstIdx    ref_targets[iRefCnt]
+//    uint      sym_offset[iSymCnt], sym_length[iSymCnt]
+//    char      text[iTextSize]
+//  Loading checks every index against the counts, copies the arrays and
+//  points the symbols at the mapped text; the text itself is not copied,
+//  so the mapping must outlive the symbols. Hashes and the lookup table
+//  are not stored but rebuilt from the text, so a damaged image cannot
+//  leave a table that misses or never ends a probe. uChecksum covers all
+//  of the arrays, as damage that passes every bounds check would still
+//  change the generated code.
+struct SSnapshotHeader
+{
+	char acMagic[4];
+	unsigned int iVersion;
+	unsigned long long uKey;
+	unsigned long long uChecksum;
+	unsigned int iNodeCnt;
+	unsigned int iChildCnt;
+	unsigned int iRefCnt;
+	unsigned int iSymCnt;
+	unsigned int iTextSize;
+};
+
+class IdlSnapshot
+{
+protected:
+	static const unsigned int VERSION = 2;
+
+	// 64-bit FNV-1a
+	static unsigned long long _checksum( const char *pcData, size_t iLength )
+	{
+		unsigned long long uHash = 14695981039346656037ull;
+		for( size_t i = 0; i < iLength; ++i ) {
+			uHash = ( uHash ^ (unsigned char)pcData[i] ) * 1099511628211ull;
+		}
+		return uHash;
+	}
+
+	template< typename T >
+	static void _put( IdlOutput& xOut, const T *pItems, size_t iCount )
+	{
+		xOut.append( (const char*)pItems, iCount * sizeof(T) );
+	}
+
+	// Copies iCount items out of the mapped image, advancing pcCur
+	template< typename T >
+	static bool _get( const char *&pcCur, const char *pcEnd, std::vector<T>& vItems, size_t iCount )
+	{
+		if( (size_t)( pcEnd - pcCur ) / sizeof(T) < iCount ) {
+			return false;
+		}
+		vItems.resize( iCount );
+		if( iCount ) {
+			memcpy( &vItems[0], pcCur, iCount * sizeof(T) );
+		}
+		pcCur += iCount * sizeof(T);
+		return true;
+	}
+
+	static bool _checkAst( const IdlAst& xAst, size_t iSymCnt )
+	{
+		size_t iNodeCnt = xAst.m_vNodes.size( );
+		if( iNodeCnt == 0 || xAst.m_vNodes[AST_ROOT].iType != ePT_Root || xAst.m_vNodes[AST_ROOT].iParent != AST_NONE ) {
+			return false;
+		}
+
+		for( size_t i = 0; i < iNodeCnt; ++i ) {
+			const SAstNode& xNode = xAst.m_vNodes[i];
+			if( xNode.iType <= ePT_Root && i != AST_ROOT ) return false;
+			if( xNode.iType > ePT_Var ) return false;
+			if( i != AST_ROOT && xNode.iParent >= i ) return false;
+			if( xNode.iName >= iSymCnt ) return false;
+			if( xNode.iChildBegin > xAst.m_vChildren.size() || xNode.iChildCnt > xAst.m_vChildren.size() - xNode.iChildBegin ) return false;
+			if( xNode.iRefBegin > xAst.m_vRefs.size() || xNode.iRefCnt > xAst.m_vRefs.size() - xNode.iRefBegin ) return false;
+			if( ( xNode.iType == ePT_Var || xNode.iType == ePT_Typedef ) && xNode.iRefCnt == 0 ) return false;
+		}
+
+		// Nodes are stored in preorder, so every child follows its parent
+		for( size_t i = 0; i < iNodeCnt; ++i ) {
+			const SAstNode& xNode = xAst.m_vNodes[i];
+			for( size_t j = 0; j < xNode.iChildCnt; ++j ) {
+				AstIdx iChild = xAst.m_vChildren[xNode.iChildBegin + j];
+				if( iChild <= i || iChild >= iNodeCnt ) return false;
+			}
+		}
+		for( auto i = xAst.m_vRefs.begin(); i != xAst.m_vRefs.end(); ++i ) {
+			if( *i >= iSymCnt ) return false;
+		}
+		for( auto i = xAst.m_vRefTargets.begin(); i != xAst.m_vRefTargets.end(); ++i ) {
+			if( *i != AST_NONE && *i >= iNodeCnt ) return false;
+		}
+
+		std::vector<unsigned char> viState( iNodeCnt, 0 );
+		for( size_t i = 0; i < iNodeCnt; ++i ) {
+			if( !_checkAcyclic( xAst, (AstIdx)i, viState ) ) return false;
+		}
+		return true;
+	}
+
+	// The generator follows inherit targets recursively, so a cycle in a
+	//  damaged image must be caught here rather than overflow the stack there
+	static bool _checkAcyclic( const IdlAst& xAst, AstIdx iNode, std::vector<unsigned char>& viState )
+	{
+		if( viState[iNode] == 2 ) return true;
+		if( viState[iNode] == 1 ) return false;
+		viState[iNode] = 1;
+
+		auto xTargets = xAst.ref_targets( iNode );
+		for( auto i = xTargets.begin(); i != xTargets.end(); ++i ) {
+			if( *i != AST_NONE && !_checkAcyclic( xAst, *i, viState ) ) return false;
+		}
+
+		viState[iNode] = 2;
+		return true;
+	}
+
+	static bool _load( const IdlInput& xImage, unsigned long long uKey, IdlSymbols& xSymbols, IdlAst& xAst )
+	{
+		const char *pcCur = xImage.begin( );
+		const char *pcEnd = xImage.end( );
+
+		SSnapshotHeader xHeader;
+		if( xImage.size() < sizeof(xHeader) ) {
+			return false;
+		}
+		memcpy( &xHeader, pcCur, sizeof(xHeader) );
+		pcCur += sizeof(xHeader);
+
+		if( memcmp( xHeader.acMagic, "IDLS", 4 ) != 0 || xHeader.iVersion != VERSION || xHeader.uKey != uKey ) {
+			return false;
+		}
+		if( _checksum( pcCur, pcEnd - pcCur ) != xHeader.uChecksum ) {
+			return false;
+		}
+
+		std::vector<unsigned int> viOffset;
+		xAst.clear( );
+		if( !_get( pcCur, pcEnd, xAst.m_vNodes, xHeader.iNodeCnt ) ||
+			!_get( pcCur, pcEnd, xAst.m_vChildren, xHeader.iChildCnt ) ||
+			!_get( pcCur, pcEnd, xAst.m_vRefs, xHeader.iRefCnt ) ||
+			!_get( pcCur, pcEnd, xAst.m_vRefTargets, xHeader.iRefCnt ) ||
+			!_get( pcCur, pcEnd, viOffset, xHeader.iSymCnt ) ||
+			!_get( pcCur, pcEnd, xSymbols.m_viLength, xHeader.iSymCnt ) ) {
+			return false;
+		}
+
+		const char *pcText = pcCur;
+		if( (size_t)( pcEnd - pcText ) != xHeader.iTextSize ) {
+			return false;
+		}
+
+		// Symbol 0 must stay the empty string
+		if( xHeader.iSymCnt == 0 || xSymbols.m_viLength[0] != 0 ) {
+			return false;
+		}
+
+		// Pointer fix-up: every symbol must lie inside the text block and
+		//  end in a NUL
+		xSymbols.m_vpcText.resize( xHeader.iSymCnt );
+		for( size_t i = 0; i < xHeader.iSymCnt; ++i ) {
+			unsigned int iOffset = viOffset[i];
+			unsigned int iLength = xSymbols.m_viLength[i];
+			if( iOffset >= xHeader.iTextSize || iLength >= xHeader.iTextSize - iOffset || pcText[iOffset + iLength] != '\0' ) {
+				return false;
+			}
+			xSymbols.m_vpcText[i] = pcText + iOffset;
+		}
+		if( !xSymbols._rehash() ) {
+			return false;
+		}
+
+		return _checkAst( xAst, xHeader.iSymCnt );
+	}
+
+public:
+	// uKey identifies the source and compiler the AST was built from
+	static void write( IdlOutput& xOut, const IdlAst& xAst, unsigned long long uKey )
+	{
+		const IdlSymbols& xSymbols = *xAst.symbols( );
+
+		std::vector<unsigned int> viOffset;
+		IdlOutput xText;
+		for( size_t i = 0; i < xSymbols.size(); ++i ) {
+			viOffset.push_back( (unsigned int)xText.size() );
+			xText.append( xSymbols.str( (SymId)i ), xSymbols.length( (SymId)i ) + 1 );
+		}
+
+		SSnapshotHeader xHeader;
+		memset( &xHeader, 0, sizeof(xHeader) );
+		memcpy( xHeader.acMagic, "IDLS", 4 );
+		xHeader.iVersion = VERSION;
+		xHeader.uKey = uKey;
+		xHeader.iNodeCnt = (unsigned int)xAst.m_vNodes.size( );
+		xHeader.iChildCnt = (unsigned int)xAst.m_vChildren.size( );
+		xHeader.iRefCnt = (unsigned int)xAst.m_vRefs.size( );
+		xHeader.iSymCnt = (unsigned int)xSymbols.size( );
+		xHeader.iTextSize = (unsigned int)xText.size( );
+
+		IdlOutput xBody;
+
+		// Copied field by field so padding bytes are always zero
+		for( auto i = xAst.m_vNodes.begin(); i != xAst.m_vNodes.end(); ++i ) {
+			SAstNode xNode;
+			memset( &xNode, 0, sizeof(xNode) );
+			xNode.iType = i->iType;
+			xNode.iSrcOffset = i->iSrcOffset;
+			xNode.iParent = i->iParent;
+			xNode.iName = i->iName;
+			xNode.iChildBegin = i->iChildBegin;
+			xNode.iChildCnt = i->iChildCnt;
+			xNode.iRefBegin = i->iRefBegin;
+			xNode.iRefCnt = i->iRefCnt;
+			_put( xBody, &xNode, 1 );
+		}
+
+		_put( xBody, xAst.m_vChildren.data(), xAst.m_vChildren.size() );
+		_put( xBody, xAst.m_vRefs.data(), xAst.m_vRefs.size() );
+		_put( xBody, xAst.m_vRefTargets.data(), xAst.m_vRefTargets.size() );
+		_put( xBody, viOffset.data(), viOffset.size() );
+		_put( xBody, xSymbols.m_viLength.data(), xSymbols.m_viLength.size() );
+		xBody.append( xText.data(), xText.size() );
+
+		xHeader.uChecksum = _checksum( xBody.data(), xBody.size() );
+		_put( xOut, &xHeader, 1 );
+		xOut.append( xBody.data(), xBody.size() );
+	}
+
+	// Rebuilds xAst and xSymbols from a mapped snapshot. Returns false if
+	//  the image is for another key or fails any check, leaving both as a
+	//  freshly constructed parser has them so the input can be parsed instead.
+	static bool load( const IdlInput& xImage, unsigned long long uKey, IdlSymbols& xSymbols, IdlAst& xAst )
+	{
+		if( !_load( xImage, uKey, xSymbols, xAst ) ) {
+			xSymbols.clear( );
+			xAst.clear( );
+			xAst.add_node( ePT_Root, AST_NONE, 0 );
+			return false;
+		}
+		return true;
+	}
+};
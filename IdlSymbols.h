@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <string.h>
+
+typedef unsigned int SymId;
+
+static const SymId SYM_EMPTY = 0;
+static const SymId SYM_NONE = 0xFFFFFFFF;
+
+// String interner shared by the lexer, parser, resolver and generator.
+//  Each distinct identifier is stored once and named by a small integer,
+//  so every later comparison is an integer compare. Text lives in fixed
+//  blocks that never move, and every string is NUL-terminated so it can
+//  be handed straight to printf.
+class IdlSymbols
+{
+	friend class IdlSnapshot;
+
+protected:
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	std::vector<char*> m_vpcBlocks;
+	char *m_pcBlockCur;
+	size_t m_iBlockLeft;
+
+	std::vector<const char*> m_vpcText;
+	std::vector<unsigned int> m_viLength;
+	std::vector<unsigned int> m_viHash;
+
+	// Open-addressed, power-of-two sized; SYM_EMPTY marks a free slot
+	std::vector<SymId> m_viTable;
+
+	static unsigned int _hash( std::string_view sText )
+	{
+		unsigned int uHash = 2166136261u;
+		for( size_t i = 0; i < sText.size(); ++i ) {
+			uHash = ( uHash ^ (unsigned char)sText[i] ) * 16777619u;
+		}
+		return uHash;
+	}
+
+	const char* _store( std::string_view sText )
+	{
+		size_t iNeed = sText.size( ) + 1;
+		if( iNeed > m_iBlockLeft ) {
+			size_t iSize = iNeed > BLOCK_SIZE ? iNeed : BLOCK_SIZE;
+			m_pcBlockCur = new char[iSize];
+			m_iBlockLeft = iSize;
+			m_vpcBlocks.push_back( m_pcBlockCur );
+		}
+
+		char *pcText = m_pcBlockCur;
+		memcpy( pcText, sText.data(), sText.size() );
+		pcText[sText.size()] = '\0';
+		m_pcBlockCur += iNeed;
+		m_iBlockLeft -= iNeed;
+		return pcText;
+	}
+
+	size_t _slot( std::string_view sText, unsigned int uHash ) const
+	{
+		size_t iMask = m_viTable.size( ) - 1;
+		size_t iSlot = uHash & iMask;
+		while( true ) {
+			SymId iSym = m_viTable[iSlot];
+			if( iSym == SYM_EMPTY ) {
+				return iSlot;
+			}
+			if( m_viHash[iSym] == uHash && m_viLength[iSym] == sText.size() && memcmp( m_vpcText[iSym], sText.data(), sText.size() ) == 0 ) {
+				return iSlot;
+			}
+			iSlot = ( iSlot + 1 ) & iMask;
+		}
+	}
+
+	void _grow( )
+	{
+		std::vector<SymId> viOld;
+		viOld.swap( m_viTable );
+		m_viTable.assign( viOld.size() * 2, SYM_EMPTY );
+
+		size_t iMask = m_viTable.size( ) - 1;
+		for( auto i = viOld.begin(); i != viOld.end(); ++i ) {
+			if( *i == SYM_EMPTY ) {
+				continue;
+			}
+			size_t iSlot = m_viHash[*i] & iMask;
+			while( m_viTable[iSlot] != SYM_EMPTY ) {
+				iSlot = ( iSlot + 1 ) & iMask;
+			}
+			m_viTable[iSlot] = *i;
+		}
+	}
+
+	// Recomputes every hash from m_vpcText and m_viLength and enters each
+	//  symbol in a fresh table, for symbols loaded rather than interned.
+	//  Fails if a symbol other than SYM_EMPTY is empty or one text
+	//  appears twice, as interning never allows either.
+	bool _rehash( )
+	{
+		size_t iTableSize = 1024;
+		while( iTableSize < m_vpcText.size() * 2 ) {
+			iTableSize *= 2;
+		}
+		m_viTable.assign( iTableSize, SYM_EMPTY );
+		m_viHash.assign( m_vpcText.size(), 0 );
+
+		for( size_t i = 1; i < m_vpcText.size(); ++i ) {
+			std::string_view sText = view( (SymId)i );
+			if( sText.empty() ) {
+				return false;
+			}
+			m_viHash[i] = _hash( sText );
+			size_t iSlot = _slot( sText, m_viHash[i] );
+			if( m_viTable[iSlot] != SYM_EMPTY ) {
+				return false;
+			}
+			m_viTable[iSlot] = (SymId)i;
+		}
+		return true;
+	}
+
+public:
+	IdlSymbols( )
+		: m_pcBlockCur(nullptr), m_iBlockLeft(0)
+	{
+		m_viTable.assign( 1024, SYM_EMPTY );
+
+		// SYM_EMPTY is the empty string and is never entered in the table
+		m_vpcText.push_back( "" );
+		m_viLength.push_back( 0 );
+		m_viHash.push_back( 0 );
+	}
+
+	~IdlSymbols( )
+	{
+		for( auto i = m_vpcBlocks.begin(); i != m_vpcBlocks.end(); ++i ) {
+			delete[] *i;
+		}
+	}
+
+	// Forgets every symbol except SYM_EMPTY
+	void clear( )
+	{
+		for( auto i = m_vpcBlocks.begin(); i != m_vpcBlocks.end(); ++i ) {
+			delete[] *i;
+		}
+		m_vpcBlocks.clear( );
+		m_pcBlockCur = nullptr;
+		m_iBlockLeft = 0;
+
+		m_viTable.assign( 1024, SYM_EMPTY );
+		m_vpcText.assign( 1, "" );
+		m_viLength.assign( 1, 0 );
+		m_viHash.assign( 1, 0 );
+	}
+
+	SymId intern( std::string_view sText )
+	{
+		if( sText.empty() ) {
+			return SYM_EMPTY;
+		}
+
+		unsigned int uHash = _hash( sText );
+		size_t iSlot = _slot( sText, uHash );
+		if( m_viTable[iSlot] != SYM_EMPTY ) {
+			return m_viTable[iSlot];
+		}
+
+		SymId iSym = (SymId)m_vpcText.size( );
+		m_vpcText.push_back( _store(sText) );
+		m_viLength.push_back( (unsigned int)sText.size() );
+		m_viHash.push_back( uHash );
+		m_viTable[iSlot] = iSym;
+
+		// Keep the load factor under one half
+		if( m_vpcText.size() * 2 > m_viTable.size() ) {
+			_grow( );
+		}
+		return iSym;
+	}
+
+	// Returns SYM_NONE when the text has never been interned
+	SymId find( std::string_view sText ) const
+	{
+		if( sText.empty() ) {
+			return SYM_EMPTY;
+		}
+
+		SymId iSym = m_viTable[_slot( sText, _hash(sText) )];
+		return iSym != SYM_EMPTY ? iSym : SYM_NONE;
+	}
+
+	const char* str( SymId iSym ) const { return m_vpcText[iSym]; }
+	size_t length( SymId iSym ) const { return m_viLength[iSym]; }
+	std::string_view view( SymId iSym ) const { return std::string_view( m_vpcText[iSym], m_viLength[iSym] ); }
+	size_t size( ) const { return m_vpcText.size(); }
+
+	size_t memory_usage( ) const
+	{
+		return m_vpcBlocks.size() * BLOCK_SIZE +
+			m_vpcText.capacity() * sizeof(const char*) +
+			m_viLength.capacity() * sizeof(unsigned int) +
+			m_viHash.capacity() * sizeof(unsigned int) +
+			m_viTable.capacity() * sizeof(SymId);
+	}
+
+private:
+	IdlSymbols( const IdlSymbols& );
+	IdlSymbols& operator=( const IdlSymbols& );
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include "IdlOutput.h"
+
+struct SSynthOptions
+{
+	unsigned int iDecls;		// messages and bases together
+	unsigned int iFields;		// vars per message, not counting lists
+	unsigned int iDepth;		// bases each message inherits through
+	unsigned int iListDepth;	// nesting of the list in each message; 0 for none
+	unsigned int iNamespaces;	// messages are spread evenly across these
+
+	SSynthOptions( )
+		: iDecls(1000), iFields(8), iDepth(2), iListDepth(1), iNamespaces(4)
+	{
+	}
+};
+
+// Writes a schema of a given shape for benchmarking the v2 front end.
+//  Every namespace gets a chain of iDepth bases, each inheriting the one
+//  before, and every message inherits the last of them. Field types cycle
+//  through the primitives with the odd typedef, array and string mixed
+//  in, so every generator path is exercised. Names are unique across the
+//  whole schema, and the output is the same for the same options.
+class IdlSynth
+{
+protected:
+	static const char* _fieldType( unsigned int iField )
+	{
+		static const char *s_apcTypes[] = {
+			"uint32", "int16", "float", "uint8", "Handle", "int64", "double", "string"
+		};
+		return s_apcTypes[iField % ( sizeof(s_apcTypes) / sizeof(s_apcTypes[0]) )];
+	}
+
+	static void _fields( IdlOutput& xOut, unsigned int iCount )
+	{
+		for( unsigned int i = 0; i < iCount; ++i ) {
+			if( i % 5 == 4 ) {
+				xOut.line( "%s f%d[%d];\n", _fieldType(i), (int)i, (int)( 2 + i % 7 ) );
+			} else {
+				xOut.line( "%s f%d;\n", _fieldType(i), (int)i );
+			}
+		}
+	}
+
+	static void _list( IdlOutput& xOut, unsigned int iMessage, unsigned int iLevel, unsigned int iDepth )
+	{
+		xOut.line( "list L%d_%d {\n", (int)iMessage, (int)iLevel );
+		xOut.indent( +1 );
+		_fields( xOut, 2 );
+		if( iLevel + 1 < iDepth ) {
+			_list( xOut, iMessage, iLevel + 1, iDepth );
+		}
+		xOut.indent( -1 );
+		xOut.line( "};\n" );
+	}
+
+public:
+	// Number of messages write() will emit for these options
+	static unsigned int message_cnt( const SSynthOptions& xOpts )
+	{
+		unsigned int iNamespaces = xOpts.iNamespaces ? xOpts.iNamespaces : 1;
+		unsigned int iBases = iNamespaces * xOpts.iDepth;
+		return xOpts.iDecls > iBases ? xOpts.iDecls - iBases : 0;
+	}
+
+	static void write( IdlOutput& xOut, const SSynthOptions& xOpts )
+	{
+		unsigned int iNamespaces = xOpts.iNamespaces ? xOpts.iNamespaces : 1;
+		unsigned int iMessages = message_cnt( xOpts );
+
+		xOut.line( "@type uint32 Handle;\n" );
+
+		unsigned int iMessage = 0;
+		for( unsigned int n = 0; n < iNamespaces; ++n ) {
+			xOut.line( "namespace N%d {\n", (int)n );
+			xOut.indent( +1 );
+
+			for( unsigned int b = 0; b < xOpts.iDepth; ++b ) {
+				if( b == 0 ) {
+					xOut.line( "base B%d_%d {\n", (int)n, (int)b );
+				} else {
+					xOut.line( "base B%d_%d : B%d_%d {\n", (int)n, (int)b, (int)n, (int)( b - 1 ) );
+				}
+				xOut.indent( +1 );
+				xOut.line( "uint16 b%d_%d;\n", (int)n, (int)b );
+				xOut.indent( -1 );
+				xOut.line( "};\n" );
+			}
+
+			unsigned int iEnd = (unsigned int)( (unsigned long long)iMessages * ( n + 1 ) / iNamespaces );
+			for( ; iMessage < iEnd; ++iMessage ) {
+				if( xOpts.iDepth ) {
+					xOut.line( "message M%d : B%d_%d {\n", (int)iMessage, (int)n, (int)( xOpts.iDepth - 1 ) );
+				} else {
+					xOut.line( "message M%d {\n", (int)iMessage );
+				}
+				xOut.indent( +1 );
+				_fields( xOut, xOpts.iFields );
+				if( xOpts.iListDepth ) {
+					_list( xOut, iMessage, 0, xOpts.iListDepth );
+				}
+				xOut.indent( -1 );
+				xOut.line( "};\n" );
+			}
+
+			xOut.indent( -1 );
+			xOut.line( "};\n" );
+		}
+	}
+};
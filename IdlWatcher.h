@@ -0,0 +1,260 @@
+#pragma once
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// Watches a set of files for saves. The directories holding them are
+//  watched rather than the files, since most editors save by writing a
+//  new file and renaming it over the old one, which would drop a watch
+//  placed on the file itself.
+class IdlWatcher
+{
+protected:
+	struct SWatchDir
+	{
+		std::string sDir;
+#ifdef _WIN32
+		HANDLE hDir;
+		OVERLAPPED xOverlapped;
+		DWORD aiBuffer[16 * 1024];
+#else
+		int iWd;
+#endif
+	};
+
+	struct SWatchFile
+	{
+		size_t iDir;
+		std::string sName;
+		size_t iId;
+	};
+
+	std::vector<SWatchDir*> m_vpDirs;
+	std::vector<SWatchFile> m_vFiles;
+#ifndef _WIN32
+	int m_iFd;
+#endif
+
+	static void _splitPath( const std::string& sPath, std::string& sDir, std::string& sName )
+	{
+		size_t iSlash = sPath.find_last_of( "/\\" );
+		if( iSlash == std::string::npos ) {
+			sDir = ".";
+			sName = sPath;
+		} else {
+			sDir = sPath.substr( 0, iSlash + 1 );
+			sName = sPath.substr( iSlash + 1 );
+		}
+	}
+
+	// Adds the id of every file in iDir called sName, once
+	void _match( size_t iDir, const std::string& sName, std::vector<size_t>& viChanged ) const
+	{
+		for( auto i = m_vFiles.begin(); i != m_vFiles.end(); ++i ) {
+			if( i->iDir != iDir || i->sName != sName ) {
+				continue;
+			}
+
+			bool bSeen = false;
+			for( auto j = viChanged.begin(); j != viChanged.end(); ++j ) {
+				if( *j == i->iId ) {
+					bSeen = true;
+				}
+			}
+			if( !bSeen ) {
+				viChanged.push_back( i->iId );
+			}
+		}
+	}
+
+#ifdef _WIN32
+	bool _arm( SWatchDir *pDir )
+	{
+		return ReadDirectoryChangesW( pDir->hDir, pDir->aiBuffer, sizeof(pDir->aiBuffer), FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, NULL, &pDir->xOverlapped, NULL ) != 0;
+	}
+
+	void _drain( size_t iDir, std::vector<size_t>& viChanged )
+	{
+		SWatchDir *pDir = m_vpDirs[iDir];
+		DWORD iBytes = 0;
+		if( GetOverlappedResult( pDir->hDir, &pDir->xOverlapped, &iBytes, FALSE ) && iBytes > 0 ) {
+			const char *pcCur = (const char*)pDir->aiBuffer;
+			for( ;; ) {
+				const FILE_NOTIFY_INFORMATION *pInfo = (const FILE_NOTIFY_INFORMATION*)pcCur;
+				if( pInfo->Action == FILE_ACTION_MODIFIED || pInfo->Action == FILE_ACTION_ADDED || pInfo->Action == FILE_ACTION_RENAMED_NEW_NAME ) {
+					char acName[MAX_PATH * 2];
+					int iLength = WideCharToMultiByte( CP_ACP, 0, pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR), acName, sizeof(acName), NULL, NULL );
+					if( iLength > 0 ) {
+						_match( iDir, std::string( acName, iLength ), viChanged );
+					}
+				}
+				if( pInfo->NextEntryOffset == 0 ) {
+					break;
+				}
+				pcCur += pInfo->NextEntryOffset;
+			}
+		}
+		ResetEvent( pDir->xOverlapped.hEvent );
+		_arm( pDir );
+	}
+#endif
+
+public:
+	IdlWatcher( )
+	{
+#ifndef _WIN32
+		m_iFd = inotify_init( );
+#endif
+	}
+
+	~IdlWatcher( )
+	{
+		for( auto i = m_vpDirs.begin(); i != m_vpDirs.end(); ++i ) {
+#ifdef _WIN32
+			CancelIo( (*i)->hDir );
+			CloseHandle( (*i)->hDir );
+			CloseHandle( (*i)->xOverlapped.hEvent );
+#endif
+			delete *i;
+		}
+#ifndef _WIN32
+		if( m_iFd >= 0 ) {
+			close( m_iFd );
+		}
+#endif
+	}
+
+	// Starts watching sPath; wait() reports a save to it as iId
+	bool add( const std::string& sPath, size_t iId )
+	{
+		SWatchFile xFile;
+		std::string sDir;
+		_splitPath( sPath, sDir, xFile.sName );
+		xFile.iId = iId;
+
+		for( xFile.iDir = 0; xFile.iDir < m_vpDirs.size(); ++xFile.iDir ) {
+			if( m_vpDirs[xFile.iDir]->sDir == sDir ) {
+				break;
+			}
+		}
+
+		if( xFile.iDir == m_vpDirs.size() ) {
+			SWatchDir *pDir = new SWatchDir;
+			pDir->sDir = sDir;
+#ifdef _WIN32
+			// Each directory waits on its own event, and there can only be
+			//  MAXIMUM_WAIT_OBJECTS of those
+			if( m_vpDirs.size() == MAXIMUM_WAIT_OBJECTS ) {
+				delete pDir;
+				return false;
+			}
+			pDir->hDir = CreateFileA( sDir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+			if( pDir->hDir == INVALID_HANDLE_VALUE ) {
+				delete pDir;
+				return false;
+			}
+			memset( &pDir->xOverlapped, 0, sizeof(pDir->xOverlapped) );
+			pDir->xOverlapped.hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+			if( !pDir->xOverlapped.hEvent || !_arm( pDir ) ) {
+				CloseHandle( pDir->hDir );
+				if( pDir->xOverlapped.hEvent ) {
+					CloseHandle( pDir->xOverlapped.hEvent );
+				}
+				delete pDir;
+				return false;
+			}
+#else
+			pDir->iWd = m_iFd < 0 ? -1 : inotify_add_watch( m_iFd, sDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+			if( pDir->iWd < 0 ) {
+				delete pDir;
+				return false;
+			}
+#endif
+			m_vpDirs.push_back( pDir );
+		}
+
+		m_vFiles.push_back( xFile );
+		return true;
+	}
+
+	// Blocks until at least one watched file has been saved, then returns
+	//  the ids of every watched file saved since the last call. Returns
+	//  false if the watch itself has failed.
+	bool wait( std::vector<size_t>& viChanged )
+	{
+		viChanged.clear( );
+		if( m_vpDirs.empty() ) {
+			return false;
+		}
+
+		while( viChanged.empty() ) {
+#ifdef _WIN32
+			std::vector<HANDLE> vhEvents;
+			for( auto i = m_vpDirs.begin(); i != m_vpDirs.end(); ++i ) {
+				vhEvents.push_back( (*i)->xOverlapped.hEvent );
+			}
+
+			DWORD iResult = WaitForMultipleObjects( (DWORD)vhEvents.size(), &vhEvents[0], FALSE, INFINITE );
+			if( iResult >= WAIT_OBJECT_0 + vhEvents.size() ) {
+				return false;
+			}
+
+			// Pick up any other directory that fired at the same time
+			for( size_t i = 0; i < vhEvents.size(); ++i ) {
+				if( WaitForSingleObject( vhEvents[i], 0 ) == WAIT_OBJECT_0 ) {
+					_drain( i, viChanged );
+				}
+			}
+#else
+			alignas(struct inotify_event) char acBuffer[16 * 1024];
+			ssize_t iRead = read( m_iFd, acBuffer, sizeof(acBuffer) );
+			if( iRead <= 0 ) {
+				return false;
+			}
+
+			// A single save can arrive as several events spread over more
+			//  than one read, so take whatever else is already queued
+			for( ;; ) {
+				for( ssize_t iPos = 0; iPos < iRead; ) {
+					const struct inotify_event *pEvent = (const struct inotify_event*)( acBuffer + iPos );
+					for( size_t i = 0; i < m_vpDirs.size(); ++i ) {
+						if( m_vpDirs[i]->iWd == pEvent->wd && pEvent->len > 0 ) {
+							_match( i, pEvent->name, viChanged );
+						}
+					}
+					iPos += sizeof(struct inotify_event) + pEvent->len;
+				}
+
+				struct pollfd xPoll;
+				xPoll.fd = m_iFd;
+				xPoll.events = POLLIN;
+				if( poll( &xPoll, 1, 0 ) <= 0 ) {
+					break;
+				}
+				iRead = read( m_iFd, acBuffer, sizeof(acBuffer) );
+				if( iRead <= 0 ) {
+					break;
+				}
+			}
+#endif
+		}
+		return true;
+	}
+
+private:
+	IdlWatcher( const IdlWatcher& );
+	IdlWatcher& operator=( const IdlWatcher& );
+};
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+
+// Runtime for the code netcompile and netcompilev2 generate. Include it
+//  ahead of any generated header.
+//
+// Values go on the wire in host byte order with no padding, the layout
+//  v1 output has always used, so v1 and v2 peers can talk to each other.
+//  Strings are written with their terminating NUL. A list is its count
+//  followed by its elements; v1 schemas name the count's type, and v2
+//  always uses a uint32. Every load and store goes through memcpy, so a
+//  field may sit at any offset even on targets that fault on unaligned
+//  access; for a fixed size the compiler turns the memcpy into a single
+//  move.
+//
+// Each write and read call gets the buffer's capacity. A field that does
+//  not fit is left untouched, but pos still advances past it. After
+//  serialize(), a result above max_len means the buffer was too small,
+//  and the result is the size it needed to be. A string read with no NUL
+//  before max_len moves pos past max_len as well.
+//
+// put, get, put_arr and get_arr are the same without the capacity check,
+//  for generated code that has already checked a whole message fits.
+//  The *_block calls copy a run of members whose layout in memory is
+//  their wire layout, which generated code asserts with offsetof.
+//
+// The view_X classes netcompilev2 generates read a message where it lies
+//  in the receive buffer. parse() checks the whole message once, with
+//  the skip_* calls, and the accessors then read through peek,
+//  array_view, string_at and list_view with no checks of their own.
+//
+// Define NET_ENCODING_NO_TYPES to supply the net:: integer types, string
+//  and packet yourself.
+namespace net {
+
+#ifndef NET_ENCODING_NO_TYPES
+	typedef signed char int8;
+	typedef unsigned char uint8;
+	typedef short int16;
+	typedef unsigned short uint16;
+	typedef int int32;
+	typedef unsigned int uint32;
+	typedef long long int64;
+	typedef unsigned long long uint64;
+	typedef std::string string;
+
+	struct packet
+	{
+	};
+#endif
+
+	namespace encoding {
+
+		inline bool fits( size_t pos, size_t size, int max_len )
+		{
+			return max_len >= 0 && pos <= (size_t)max_len && size <= (size_t)max_len - pos;
+		}
+
+		template< typename T >
+		inline void put( const T& val, char *data, size_t& pos )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "no wire encoding for this type" );
+			memcpy( data + pos, &val, sizeof(T) );
+			pos += sizeof(T);
+		}
+
+		template< typename T >
+		inline void get( T& val, const char *data, size_t& pos )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "no wire encoding for this type" );
+			memcpy( &val, data + pos, sizeof(T) );
+			pos += sizeof(T);
+		}
+
+		template< typename T >
+		inline void put_arr( const T *val, size_t count, char *data, size_t& pos )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "no wire encoding for this type" );
+			memcpy( data + pos, val, sizeof(T) * count );
+			pos += sizeof(T) * count;
+		}
+
+		template< typename T >
+		inline void get_arr( T *val, size_t count, const char *data, size_t& pos )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "no wire encoding for this type" );
+			memcpy( val, data + pos, sizeof(T) * count );
+			pos += sizeof(T) * count;
+		}
+
+		// size may be 0 for an empty list, whose vector may have no storage
+		//  at all, so memcpy is not called for it
+		inline void put_block( const void *val, size_t size, char *data, size_t& pos )
+		{
+			if( size == 0 ) {
+				return;
+			}
+			memcpy( data + pos, val, size );
+			pos += size;
+		}
+
+		inline void get_block( void *val, size_t size, const char *data, size_t& pos )
+		{
+			if( size == 0 ) {
+				return;
+			}
+			memcpy( val, data + pos, size );
+			pos += size;
+		}
+
+		inline void write_block( const void *val, size_t size, char *data, size_t& pos, int max_len )
+		{
+			if( fits( pos, size, max_len ) ) {
+				put_block( val, size, data, pos );
+			} else {
+				pos += size;
+			}
+		}
+
+		inline void read_block( void *val, size_t size, const char *data, size_t& pos, int max_len )
+		{
+			if( fits( pos, size, max_len ) ) {
+				get_block( val, size, data, pos );
+			} else {
+				pos += size;
+			}
+		}
+
+		template< typename T >
+		inline void store( const T& val, char *data, size_t& pos, int max_len )
+		{
+			if( fits( pos, sizeof(T), max_len ) ) {
+				put( val, data, pos );
+			} else {
+				pos += sizeof(T);
+			}
+		}
+
+		template< typename T >
+		inline void load( T& val, const char *data, size_t& pos, int max_len )
+		{
+			if( fits( pos, sizeof(T), max_len ) ) {
+				get( val, data, pos );
+			} else {
+				pos += sizeof(T);
+			}
+		}
+
+#define NET_ENCODING_PRIMITIVES( PRIM ) \
+		PRIM( int8 ) \
+		PRIM( uint8 ) \
+		PRIM( int16 ) \
+		PRIM( uint16 ) \
+		PRIM( int32 ) \
+		PRIM( uint32 ) \
+		PRIM( int64 ) \
+		PRIM( uint64 ) \
+		PRIM( float ) \
+		PRIM( double ) \
+		PRIM( bool ) \
+		PRIM( char )
+
+		// Exact overloads for the schema primitives, so they never go
+		//  through the template below
+#define NET_ENCODING_PRIMITIVE( T ) \
+		inline void write( T val, char *data, size_t& pos, int max_len ) { store( val, data, pos, max_len ); } \
+		inline void read( T& val, const char *data, size_t& pos, int max_len ) { load( val, data, pos, max_len ); }
+		NET_ENCODING_PRIMITIVES( NET_ENCODING_PRIMITIVE )
+#undef NET_ENCODING_PRIMITIVE
+
+		// Enums and anything else stored as its raw bytes
+		template< typename T >
+		inline void write( const T& val, char *data, size_t& pos, int max_len )
+		{
+			store( val, data, pos, max_len );
+		}
+
+		template< typename T >
+		inline void read( T& val, const char *data, size_t& pos, int max_len )
+		{
+			load( val, data, pos, max_len );
+		}
+
+		inline void write( const std::string& val, char *data, size_t& pos, int max_len )
+		{
+			size_t iSize = val.size( ) + 1;
+			if( fits( pos, iSize, max_len ) ) {
+				memcpy( data + pos, val.c_str(), iSize );
+			}
+			pos += iSize;
+		}
+
+		inline void read( std::string& val, const char *data, size_t& pos, int max_len )
+		{
+			if( !fits( pos, 0, max_len ) ) {
+				pos++;
+				return;
+			}
+
+			const char *pcEnd = (const char*)memchr( data + pos, '\0', (size_t)max_len - pos );
+			if( !pcEnd ) {
+				pos = (size_t)max_len + 1;
+				return;
+			}
+			val.assign( data + pos, pcEnd );
+			pos += val.size( ) + 1;
+		}
+
+		// A list's element count goes on the wire as a uint32
+		template< typename T >
+		inline void write_count( const std::vector<T>& vec, char *data, size_t& pos, int max_len )
+		{
+			store( (uint32)vec.size( ), data, pos, max_len );
+		}
+
+		// Reads a count and sizes vec to it. Each element takes at least
+		//  min_size bytes, so a count the rest of the buffer cannot hold
+		//  is an overflow: vec is left empty and pos moves past max_len.
+		template< typename T >
+		inline void read_count( std::vector<T>& vec, size_t min_size, const char *data, size_t& pos, int max_len )
+		{
+			uint32 count = 0;
+			load( count, data, pos, max_len );
+			if( !fits( pos, (size_t)count * ( min_size ? min_size : 1 ), max_len ) ) {
+				vec.clear( );
+				if( pos <= (size_t)max_len ) {
+					pos = (size_t)max_len + 1;
+				}
+				return;
+			}
+			vec.resize( count );
+		}
+
+		// Arrays of raw-byte types are copied as one block, since their
+		//  wire layout is their layout in memory
+		template< typename T >
+		inline void write_arr( const T *val, size_t count, char *data, size_t& pos, int max_len )
+		{
+			if constexpr( std::is_trivially_copyable<T>::value ) {
+				if( fits( pos, sizeof(T) * count, max_len ) ) {
+					put_arr( val, count, data, pos );
+				} else {
+					pos += sizeof(T) * count;
+				}
+			} else {
+				for( size_t i = 0; i < count; ++i ) {
+					write( val[i], data, pos, max_len );
+				}
+			}
+		}
+
+		template< typename T >
+		inline void read_arr( T *val, size_t count, const char *data, size_t& pos, int max_len )
+		{
+			if constexpr( std::is_trivially_copyable<T>::value ) {
+				if( fits( pos, sizeof(T) * count, max_len ) ) {
+					get_arr( val, count, data, pos );
+				} else {
+					pos += sizeof(T) * count;
+				}
+			} else {
+				for( size_t i = 0; i < count; ++i ) {
+					read( val[i], data, pos, max_len );
+				}
+			}
+		}
+
+		template< typename T >
+		inline T peek( const char *data )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "no wire encoding for this type" );
+			T val;
+			memcpy( &val, data, sizeof(T) );
+			return val;
+		}
+
+		// A fixed-length array where it lies. Elements come back by value,
+		//  since on the wire they need not be aligned.
+		template< typename T >
+		class array_view
+		{
+		protected:
+			const char *m_pcData;
+			size_t m_iCount;
+
+		public:
+			array_view( const char *data, size_t count ) : m_pcData(data), m_iCount(count) { }
+
+			size_t size( ) const { return m_iCount; }
+			const char* data( ) const { return m_pcData; }
+			T operator[]( size_t idx ) const { return peek<T>( m_pcData + idx * sizeof(T) ); }
+		};
+
+		// The idx'th of an array of strings that skip_strings has checked
+		inline std::string_view string_at( const char *data, size_t idx )
+		{
+			for( ; idx; --idx ) {
+				data += strlen( data ) + 1;
+			}
+			return std::string_view( data );
+		}
+
+		// The skip_* calls return the position after what they skip, or
+		//  a position above max_len when it does not fit, as reads do
+		inline size_t skip_string( const char *data, size_t pos, int max_len )
+		{
+			if( !fits( pos, 0, max_len ) ) {
+				return pos + 1;
+			}
+
+			const char *pcEnd = (const char*)memchr( data + pos, '\0', (size_t)max_len - pos );
+			if( !pcEnd ) {
+				return (size_t)max_len + 1;
+			}
+			return (size_t)( pcEnd - data ) + 1;
+		}
+
+		inline size_t skip_strings( const char *data, size_t pos, size_t count, int max_len )
+		{
+			for( size_t i = 0; i < count; ++i ) {
+				pos = skip_string( data, pos, max_len );
+			}
+			return pos;
+		}
+
+		// A list whose elements all take elem_size bytes
+		inline size_t skip_block_list( const char *data, size_t pos, size_t elem_size, int max_len )
+		{
+			if( !fits( pos, sizeof(uint32), max_len ) ) {
+				return pos + sizeof(uint32);
+			}
+			size_t count = peek<uint32>( data + pos );
+			pos += sizeof(uint32);
+			if( elem_size && count > ( (size_t)max_len - pos ) / elem_size ) {
+				return (size_t)max_len + 1;
+			}
+			return pos + count * elem_size;
+		}
+
+		// A list of elements of view type T, each parsed in turn. As with
+		//  read_count, a count the rest of the buffer cannot hold at
+		//  min_size bytes an element fails before any are parsed.
+		template< typename T >
+		inline size_t skip_list( const char *data, size_t pos, size_t min_size, int max_len )
+		{
+			if( !fits( pos, sizeof(uint32), max_len ) ) {
+				return pos + sizeof(uint32);
+			}
+			size_t count = peek<uint32>( data + pos );
+			pos += sizeof(uint32);
+			if( count > ( (size_t)max_len - pos ) / ( min_size ? min_size : 1 ) ) {
+				return (size_t)max_len + 1;
+			}
+
+			T elem;
+			for( size_t i = 0; i < count && pos <= (size_t)max_len; ++i ) {
+				pos = elem._parse( data, pos, max_len );
+			}
+			return pos;
+		}
+
+		// A list where it lies, for a view T of one element. Iterating
+		//  parses each element from where the one before it ended.
+		template< typename T >
+		class list_view
+		{
+		protected:
+			const char *m_pcData;
+			size_t m_iPos;
+			size_t m_iCount;
+			int m_iMaxLen;
+
+		public:
+			class iterator
+			{
+			protected:
+				const char *m_pcData;
+				size_t m_iLeft;
+				int m_iMaxLen;
+				T m_xElem;
+
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef T value_type;
+				typedef ptrdiff_t difference_type;
+				typedef const T* pointer;
+				typedef const T& reference;
+
+				iterator( ) : m_pcData(nullptr), m_iLeft(0), m_iMaxLen(0) { }
+
+				iterator( const char *data, size_t pos, size_t left, int max_len )
+					: m_pcData(data), m_iLeft(left), m_iMaxLen(max_len)
+				{
+					if( m_iLeft ) {
+						m_xElem._parse( m_pcData, pos, m_iMaxLen );
+					}
+				}
+
+				const T& operator*( ) const { return m_xElem; }
+				const T* operator->( ) const { return &m_xElem; }
+
+				iterator& operator++( )
+				{
+					if( --m_iLeft ) {
+						m_xElem._parse( m_pcData, m_xElem._end(), m_iMaxLen );
+					}
+					return *this;
+				}
+
+				iterator operator++( int )
+				{
+					iterator xOld = *this;
+					++*this;
+					return xOld;
+				}
+
+				// Only iterators over the same list compare meaningfully
+				bool operator==( const iterator& xOther ) const { return m_iLeft == xOther.m_iLeft; }
+				bool operator!=( const iterator& xOther ) const { return m_iLeft != xOther.m_iLeft; }
+			};
+
+			list_view( const char *data, size_t pos, int max_len )
+				: m_pcData(data), m_iPos(pos + sizeof(uint32)), m_iCount(peek<uint32>( data + pos )), m_iMaxLen(max_len)
+			{
+			}
+
+			size_t size( ) const { return m_iCount; }
+			bool empty( ) const { return m_iCount == 0; }
+			iterator begin( ) const { return iterator( m_pcData, m_iPos, m_iCount, m_iMaxLen ); }
+			iterator end( ) const { return iterator( ); }
+		};
+
+	};
+
+	// v1 output: reads a NUL-terminated string at cur_pos, failing when
+	//  there is no NUL before len
+	inline bool read_string( std::string& val, const char *data, int len, int& cur_pos )
+	{
+		if( cur_pos < 0 || cur_pos >= len ) {
+			return false;
+		}
+
+		const char *pcEnd = (const char*)memchr( data + cur_pos, '\0', (size_t)( len - cur_pos ) );
+		if( !pcEnd ) {
+			return false;
+		}
+		val.assign( data + cur_pos, pcEnd );
+		cur_pos += (int)val.size( ) + 1;
+		return true;
+	}
+
+};
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "NetEncoding.h"
+
+// Measures the throughput of the ::net::encoding runtime, one primitive at
+//  a time. Each run encodes, then decodes, a buffer of values with one
+//  call per value, the way generated serializers do, and then again with
+//  a single write_arr/read_arr call. One JSON object is printed per type
+//  and operation.
+
+static void printUsage( )
+{
+	printf( "usage: encbench [--values <n>] [--min-ms <ms>]\n" );
+	printf( "  --values <n>  values encoded per run (default 4096)\n" );
+	printf( "  --min-ms <ms> keep repeating an operation for at least this long (default 200)\n" );
+}
+
+// Stops the optimizer from discarding a result
+static volatile unsigned int s_uSink;
+
+template< typename TRun >
+static double timeOp( double dMinMs, TRun fnRun, unsigned int& iRuns )
+{
+	double dBest = -1;
+	double dTotal = 0;
+	for( iRuns = 0; iRuns < 3 || dTotal < dMinMs; ++iRuns ) {
+		auto xStart = std::chrono::steady_clock::now( );
+		fnRun( );
+		double dMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
+		dTotal += dMs;
+		if( dBest < 0 || dMs < dBest ) {
+			dBest = dMs;
+		}
+	}
+	return dBest;
+}
+
+static void report( const char *pcType, const char *pcOp, size_t iBytes, double dMs, unsigned int iRuns )
+{
+	printf( "{\"type\":\"%s\",\"op\":\"%s\",\"bytes\":%u,\"ms\":%.4f,\"mb_per_s\":%.1f,\"runs\":%u}\n",
+		pcType, pcOp, (unsigned)iBytes, dMs, dMs > 0 ? iBytes / ( dMs * 1000.0 ) : 0.0, iRuns );
+	fflush( stdout );
+}
+
+template< typename T >
+static void benchType( const char *pcType, size_t iValues, double dMinMs )
+{
+	// Plain arrays, since std::vector<bool> does not store bools
+	T *pIn = new T[iValues];
+	T *pOut = new T[iValues]( );
+	for( size_t i = 0; i < iValues; ++i ) {
+		unsigned long long uBits = ( i * 0x9E3779B97F4A7C15ull ) >> 17;
+		if( std::is_same<T, bool>::value ) {
+			uBits &= 1;
+		}
+		memcpy( &pIn[i], &uBits, sizeof(T) < sizeof(uBits) ? sizeof(T) : sizeof(uBits) );
+	}
+
+	// One byte in so every value after the first is misaligned
+	int iMaxLen = (int)( sizeof(T) * iValues + 1 );
+	std::vector<char> vBuffer( iMaxLen );
+	char *pcData = &vBuffer[0];
+	size_t iBytes = sizeof(T) * iValues;
+	unsigned int iRuns;
+
+	double dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		for( size_t i = 0; i < iValues; ++i ) {
+			::net::encoding::write( pIn[i], pcData, pos, iMaxLen );
+		}
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( pcType, "write", iBytes, dMs, iRuns );
+
+	dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		for( size_t i = 0; i < iValues; ++i ) {
+			::net::encoding::read( pOut[i], pcData, pos, iMaxLen );
+		}
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( pcType, "read", iBytes, dMs, iRuns );
+
+	dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		::net::encoding::write_arr( pIn, iValues, pcData, pos, iMaxLen );
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( pcType, "write_arr", iBytes, dMs, iRuns );
+
+	dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		::net::encoding::read_arr( pOut, iValues, pcData, pos, iMaxLen );
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( pcType, "read_arr", iBytes, dMs, iRuns );
+
+	if( memcmp( pIn, pOut, iBytes ) != 0 ) {
+		printf( "{\"type\":\"%s\",\"error\":\"values did not survive a round trip\"}\n", pcType );
+	}
+	delete[] pIn;
+	delete[] pOut;
+}
+
+static void benchString( size_t iValues, double dMinMs )
+{
+	std::vector<std::string> vIn( iValues );
+	std::vector<std::string> vOut( iValues );
+	size_t iBytes = 0;
+	for( size_t i = 0; i < iValues; ++i ) {
+		vIn[i].assign( 4 + i % 29, (char)( 'a' + i % 26 ) );
+		iBytes += vIn[i].size( ) + 1;
+	}
+
+	int iMaxLen = (int)( iBytes + 1 );
+	std::vector<char> vBuffer( iMaxLen );
+	char *pcData = &vBuffer[0];
+	unsigned int iRuns;
+
+	double dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		for( size_t i = 0; i < iValues; ++i ) {
+			::net::encoding::write( vIn[i], pcData, pos, iMaxLen );
+		}
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( "string", "write", iBytes, dMs, iRuns );
+
+	dMs = timeOp( dMinMs, [&]( ) {
+		size_t pos = 1;
+		for( size_t i = 0; i < iValues; ++i ) {
+			::net::encoding::read( vOut[i], pcData, pos, iMaxLen );
+		}
+		s_uSink = s_uSink + (unsigned int)pos;
+	}, iRuns );
+	report( "string", "read", iBytes, dMs, iRuns );
+
+	if( vIn != vOut ) {
+		printf( "{\"type\":\"string\",\"error\":\"values did not survive a round trip\"}\n" );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	size_t iValues = 4096;
+	double dMinMs = 200;
+
+	for( int i = 1; i < argc; ++i ) {
+		if( strcmp( argv[i], "--values" ) == 0 && i + 1 < argc ) {
+			iValues = (size_t)strtoul( argv[++i], nullptr, 10 );
+		} else if( strcmp( argv[i], "--min-ms" ) == 0 && i + 1 < argc ) {
+			dMinMs = atof( argv[++i] );
+		} else {
+			printUsage( );
+			return -1;
+		}
+	}
+	if( iValues == 0 ) {
+		printUsage( );
+		return -1;
+	}
+
+#define ENCBENCH_TYPE( T ) benchType< ::net::T >( #T, iValues, dMinMs );
+#define ENCBENCH_BUILTIN( T ) benchType< T >( #T, iValues, dMinMs );
+	ENCBENCH_TYPE( int8 )
+	ENCBENCH_TYPE( uint8 )
+	ENCBENCH_TYPE( int16 )
+	ENCBENCH_TYPE( uint16 )
+	ENCBENCH_TYPE( int32 )
+	ENCBENCH_TYPE( uint32 )
+	ENCBENCH_TYPE( int64 )
+	ENCBENCH_TYPE( uint64 )
+	ENCBENCH_BUILTIN( float )
+	ENCBENCH_BUILTIN( double )
+	ENCBENCH_BUILTIN( bool )
+	ENCBENCH_BUILTIN( char )
+#undef ENCBENCH_BUILTIN
+#undef ENCBENCH_TYPE
+	benchString( iValues, dMinMs );
+
+	return 0;
+}
@@ -0,0 +1,389 @@
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "IdlSynth.h"
+#include "IdlInput.h"
+#include "IdlLexer.h"
+#include "IdlRefLexer.h"
+#include "IdlParser.h"
+#include "IdlResolver.h"
+#include "CppGenerator.h"
+
+// Benchmarks each stage of the v2 front end on synthesized schemas of
+//  increasing size. Every stage is timed on its own, with its input built
+//  outside the timed region, and one JSON object is printed per size and
+//  stage so successive runs can be compared by a script. --verify instead
+//  checks the lexer against the original one, IdlRefLexer, on the same
+//  schemas and on a corpus of edge cases.
+
+static void printUsage( )
+{
+	printf( "usage: netbench [--sizes <n,n,...>] [--fields <n>] [--depth <n>] [--lists <n>] [--namespaces <n>] [--gen-threads <n>] [--min-ms <ms>] [--dump <n>] [--verify]\n" );
+	printf( "  --sizes <n,...>   declaration counts to benchmark (default 100,1000,10000,100000)\n" );
+	printf( "  --fields <n>      vars per message (default 8)\n" );
+	printf( "  --depth <n>       inheritance depth of each message (default 2)\n" );
+	printf( "  --lists <n>       list nesting depth in each message (default 1)\n" );
+	printf( "  --namespaces <n>  namespaces the messages are spread across (default 4)\n" );
+	printf( "  --gen-threads <n> also time generation on <n> threads, 0 for one per core\n" );
+	printf( "  --min-ms <ms>     keep repeating a stage for at least this long (default 200)\n" );
+	printf( "  --dump <n>        print the schema synthesized for <n> declarations and exit\n" );
+	printf( "  --verify          compare the lexer's tokens with the original lexer's instead of timing\n" );
+}
+
+static double msSince( std::chrono::steady_clock::time_point xStart )
+{
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
+}
+
+// Runs fnSetup then times fnRun, at least three times and until dMinMs
+//  has been spent timing. Reports the fastest run, which is the least
+//  disturbed by the rest of the machine.
+template< typename TSetup, typename TRun >
+static double timeStage( double dMinMs, TSetup fnSetup, TRun fnRun, unsigned int& iRuns )
+{
+	double dBest = -1;
+	double dTotal = 0;
+	for( iRuns = 0; iRuns < 3 || dTotal < dMinMs; ++iRuns ) {
+		fnSetup( );
+		auto xStart = std::chrono::steady_clock::now( );
+		fnRun( );
+		double dMs = msSince( xStart );
+		dTotal += dMs;
+		if( dBest < 0 || dMs < dBest ) {
+			dBest = dMs;
+		}
+	}
+	return dBest;
+}
+
+static void report( const SSynthOptions& xOpts, unsigned int iMessages, size_t iBytes, const char *pcStage, double dMs, unsigned int iRuns )
+{
+	printf( "{\"decls\":%u,\"messages\":%u,\"fields\":%u,\"depth\":%u,\"lists\":%u,\"namespaces\":%u,\"bytes\":%u,"
+		"\"stage\":\"%s\",\"ms\":%.4f,\"ns_per_decl\":%.1f,\"mb_per_s\":%.1f,\"runs\":%u}\n",
+		xOpts.iDecls, iMessages, xOpts.iFields, xOpts.iDepth, xOpts.iListDepth, xOpts.iNamespaces, (unsigned)iBytes,
+		pcStage, dMs, xOpts.iDecls ? dMs * 1e6 / xOpts.iDecls : 0.0, dMs > 0 ? iBytes / ( dMs * 1e3 ) : 0.0, iRuns );
+	fflush( stdout );
+}
+
+// JSON-safe copy of a mismatch description, which quotes token text
+static std::string jsonSafe( const std::string& sText )
+{
+	std::string sSafe( sText );
+	for( auto i = sSafe.begin(); i != sSafe.end(); ++i ) {
+		if( *i == '"' || *i == '\\' || (unsigned char)*i < 0x20 || (unsigned char)*i >= 0x7F ) {
+			*i = '?';
+		}
+	}
+	return sSafe;
+}
+
+static bool verifyText( const char *pcName, const std::string& sText, bool bExpectMatch )
+{
+	IdlInput xInput;
+	xInput.assign( sText.data(), sText.size() );
+	std::string sMismatch;
+	bool bMatch = IdlRefLexer::verify( &xInput, sMismatch );
+	printf( "{\"verify\":\"%s\",\"bytes\":%u,\"match\":%s", pcName, (unsigned)sText.size(), bMatch ? "true" : "false" );
+	if( !bMatch ) {
+		printf( ",\"mismatch\":\"%s\"", jsonSafe( sMismatch ).c_str() );
+	}
+	if( !bExpectMatch ) {
+		printf( ",\"expected\":\"mismatch\"" );
+	}
+	printf( "}\n" );
+	fflush( stdout );
+	return bMatch == bExpectMatch;
+}
+
+// Lexes each synthesized schema, as written and with CRLF line ends, and
+//  the edge cases below with both the original lexer and the current one.
+//  The literals are placed at every offset across a 64-byte span so that
+//  one of them straddles each 16- and 32-byte block IdlScan loads.
+static bool verifyLexer( SSynthOptions xOpts, const std::vector<unsigned int>& viSizes )
+{
+	int iFailed = 0;
+	char acName[64];
+
+	for( auto i = viSizes.begin(); i != viSizes.end(); ++i ) {
+		xOpts.iDecls = *i;
+		IdlOutput xSchema;
+		IdlSynth::write( xSchema, xOpts );
+		std::string sText( xSchema.data(), xSchema.size() );
+		std::string sCrlf;
+		for( auto c = sText.begin(); c != sText.end(); ++c ) {
+			if( *c == '\n' ) {
+				sCrlf += '\r';
+			}
+			sCrlf += *c;
+		}
+		snprintf( acName, sizeof(acName), "synth_%u", *i );
+		iFailed += !verifyText( acName, sText, true );
+		snprintf( acName, sizeof(acName), "synth_%u_crlf", *i );
+		iFailed += !verifyText( acName, sCrlf, true );
+	}
+
+	static const struct {
+		const char *pcName;
+		const char *pcText;
+		bool bExpectMatch;
+	} s_axCases[] = {
+		{ "empty", "", true },
+		{ "crlf", "namespace a {\r\n\tmessage M {\r\n\t\tuint32 x; // note\r\n\t\tlist L { uint8 y; };\r\n\t};\r\n};\r\n", true },
+		{ "crlf_no_final_newline", "message M {\r\n\tuint32 x;\r\n};", true },
+		{ "comment_at_eof", "message M { uint32 x; }; // end", true },
+		{ "comment_at_eof_newline", "message M { uint32 x; };\n//", true },
+		{ "comment_at_eof_crlf", "message M { uint32 x; };\r\n// end\r", true },
+		{ "comment_only", "// nothing here", true },
+		{ "comment_after_literal", "message M{uint32 x;//x\n};", true },
+		{ "tabs", "\tmessage\tM\t{\tuint32\tx\t;\t}\t;\t", true },
+		{ "non_ascii", "message M\xC3\xA9 { uint8 \xFF; uint8 a\x80" "b; };\n", true },
+		{ "keywords", "namespace n { @type u32 : uint32; enum E : uint8 { A, B }; message M : base { list L { u32 v[4]; }; }; };", true },
+		{ "literal_at_eof", "message", true },
+		{ "slash_error", "message M { uint32 x / 2; };", true },
+		{ "slash_at_eof", "message M { };\n/", true },
+		{ "slash_crlf_error", "message M {\r\n/\r\n};", true },
+		// A lone '\r' is dropped by the original, which joins the tokens
+		//  around it; the current lexer takes it as whitespace like any
+		//  other. Only '\r' before '\n' is meant to lex the same.
+		{ "lone_cr", "message\rM { };", false },
+	};
+	for( size_t i = 0; i < sizeof(s_axCases) / sizeof(s_axCases[0]); ++i ) {
+		iFailed += !verifyText( s_axCases[i].pcName, s_axCases[i].pcText, s_axCases[i].bExpectMatch );
+	}
+
+	static const char *s_apcSpans[] = {
+		"abcdefghijklmnopqrstuvwxyz0123456789_ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+		"// a comment that runs past the end of more than one block\n",
+		" \t\r\n \t\r\n \t\r\n \t\r\n \t\r\n \t\r\n \t\r\n \t\r\n \t\r\n",
+	};
+	for( size_t i = 0; i < sizeof(s_apcSpans) / sizeof(s_apcSpans[0]); ++i ) {
+		for( unsigned int iPad = 0; iPad < 64; ++iPad ) {
+			std::string sText = std::string( iPad, ' ' ) + "message M { uint32 " + s_apcSpans[i] + "x; list L { uint8 y; }; };" + s_apcSpans[i];
+			snprintf( acName, sizeof(acName), "span_%u_pad_%u", (unsigned)i, iPad );
+			iFailed += !verifyText( acName, sText, true );
+		}
+	}
+
+	return iFailed == 0;
+}
+
+// Visits every node below iNode as the resolver and generator do, reading
+//  its type, name, children and refs, and folds them into a sum the
+//  caller keeps so none of the reads can be dropped
+static size_t traverseAst( const IdlAst& xAst, AstIdx iNode )
+{
+	size_t iSum = xAst.type( iNode ) + xAst.name_id( iNode );
+	SAstRange<SymId> xRefs = xAst.refs( iNode );
+	for( auto i = xRefs.begin(); i != xRefs.end(); ++i ) {
+		iSum += *i;
+	}
+	SAstRange<AstIdx> xChildren = xAst.children( iNode );
+	for( auto i = xChildren.begin(); i != xChildren.end(); ++i ) {
+		iSum += traverseAst( xAst, *i );
+	}
+	return iSum;
+}
+
+static bool benchSize( const SSynthOptions& xOpts, double dMinMs, int iGenThreads )
+{
+	IdlOutput xSchema;
+	IdlSynth::write( xSchema, xOpts );
+	unsigned int iMessages = IdlSynth::message_cnt( xOpts );
+
+	IdlInput xInput;
+	xInput.assign( xSchema.data(), xSchema.size() );
+	size_t iBytes = xSchema.size( );
+	unsigned int iRuns;
+
+	try {
+		// Lexing interns into the symbol table, so each run starts afresh
+		IdlSymbols *pLexSymbols = nullptr;
+		IdlTokenList *pLexTokens = nullptr;
+		double dMs = timeStage( dMinMs,
+			[&]( ) {
+				delete pLexTokens;
+				delete pLexSymbols;
+				pLexSymbols = new IdlSymbols;
+				pLexTokens = new IdlTokenList;
+			},
+			[&]( ) {
+				IdlLexer xLexer( &xInput, pLexSymbols );
+				xLexer.tokenize( *pLexTokens );
+			}, iRuns );
+		delete pLexTokens;
+		delete pLexSymbols;
+		pLexSymbols = nullptr;
+		report( xOpts, iMessages, iBytes, "lex", dMs, iRuns );
+
+		// The streaming path tokenize() replaced, driven the way the old
+		//  parser drove it: a peek at every token before reading it
+		dMs = timeStage( dMinMs,
+			[&]( ) {
+				delete pLexSymbols;
+				pLexSymbols = new IdlSymbols;
+			},
+			[&]( ) {
+				IdlLexer xLexer( &xInput, pLexSymbols );
+				while( xLexer.peekToken().iType != eTok_EOF ) {
+					xLexer.readToken( );
+				}
+			}, iRuns );
+		delete pLexSymbols;
+		pLexSymbols = nullptr;
+		report( xOpts, iMessages, iBytes, "lex_stream", dMs, iRuns );
+
+		// The remaining stages share one token list and symbol table
+		IdlSymbols xSymbols;
+		IdlTokenList xTokens;
+		IdlLexer xLexer( &xInput, &xSymbols );
+		xLexer.tokenize( xTokens );
+
+		dMs = timeStage( dMinMs,
+			[&]( ) { },
+			[&]( ) {
+				IdlParser xParser( &xTokens, &xSymbols );
+				xParser.parse( );
+			}, iRuns );
+		report( xOpts, iMessages, iBytes, "parse", dMs, iRuns );
+
+		IdlParser xParser( &xTokens, &xSymbols );
+		xParser.parse( );
+
+		// The tree's own footprint, and one walk over all of it
+		const IdlAst& xParsed = xParser.get_ast( );
+		printf( "{\"decls\":%u,\"messages\":%u,\"stage\":\"ast\",\"nodes\":%u,\"memory_usage\":%u,\"bytes_per_node\":%.1f}\n",
+			xOpts.iDecls, iMessages, (unsigned)xParsed.node_cnt(), (unsigned)xParsed.memory_usage(),
+			xParsed.node_cnt() ? (double)xParsed.memory_usage() / xParsed.node_cnt() : 0.0 );
+		volatile size_t iTraverseSum = 0;
+		dMs = timeStage( dMinMs,
+			[&]( ) { },
+			[&]( ) {
+				iTraverseSum = traverseAst( xParsed, AST_ROOT );
+			}, iRuns );
+		report( xOpts, iMessages, iBytes, "traverse", dMs, iRuns );
+
+		// The resolver fills in the tree it checks, so it gets a fresh copy
+		IdlAst xAst( &xSymbols );
+		IdlLayouts xLayouts;
+		dMs = timeStage( dMinMs,
+			[&]( ) {
+				xAst = xParser.get_ast( );
+			},
+			[&]( ) {
+				IdlResolver xResolver( &xAst );
+				xResolver.validate( );
+				xResolver.take_layouts( xLayouts );
+			}, iRuns );
+		report( xOpts, iMessages, iBytes, "resolve", dMs, iRuns );
+
+		// type_id is 16 bits wide, which caps the messages one file can hold
+		if( iMessages >= 0xFFFF ) {
+			printf( "{\"decls\":%u,\"messages\":%u,\"stage\":\"generate\",\"skipped\":\"more messages than type_id can number\"}\n", xOpts.iDecls, iMessages );
+			return true;
+		}
+
+		dMs = timeStage( dMinMs,
+			[&]( ) { },
+			[&]( ) {
+				CppGenerator xGen( &xAst, &xLayouts );
+				xGen.set_command_range( 0x0000, 0xFFFF );
+				xGen.generate( );
+			}, iRuns );
+		report( xOpts, iMessages, iBytes, "generate", dMs, iRuns );
+
+		if( iGenThreads >= 0 ) {
+			dMs = timeStage( dMinMs,
+				[&]( ) { },
+				[&]( ) {
+					CppGenerator xGen( &xAst, &xLayouts );
+					xGen.set_command_range( 0x0000, 0xFFFF );
+					xGen.set_threads( (unsigned int)iGenThreads );
+					xGen.generate( );
+				}, iRuns );
+			report( xOpts, iMessages, iBytes, "generate_parallel", dMs, iRuns );
+		}
+
+	} catch( std::exception& e ) {
+		printf( "{\"decls\":%u,\"error\":\"%s\"}\n", xOpts.iDecls, e.what() );
+		return false;
+	}
+	return true;
+}
+
+int main( int argc, char* argv[] )
+{
+	SSynthOptions xOpts;
+	std::vector<unsigned int> viSizes;
+	double dMinMs = 200;
+	int iDump = -1;
+	int iGenThreads = -1;
+	bool bVerify = false;
+
+	for( int i = 1; i < argc; ++i ) {
+		if( strcmp( argv[i], "--verify" ) == 0 ) {
+			bVerify = true;
+			continue;
+		}
+		if( i + 1 >= argc ) {
+			printUsage( );
+			return -1;
+		}
+
+		if( strcmp( argv[i], "--sizes" ) == 0 ) {
+			for( char *pcNum = argv[++i]; *pcNum; ) {
+				viSizes.push_back( (unsigned int)strtoul( pcNum, &pcNum, 10 ) );
+				if( *pcNum == ',' ) {
+					pcNum++;
+				}
+			}
+		} else if( strcmp( argv[i], "--fields" ) == 0 ) {
+			xOpts.iFields = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--depth" ) == 0 ) {
+			xOpts.iDepth = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--lists" ) == 0 ) {
+			xOpts.iListDepth = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--namespaces" ) == 0 ) {
+			xOpts.iNamespaces = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--gen-threads" ) == 0 ) {
+			iGenThreads = atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--min-ms" ) == 0 ) {
+			dMinMs = atof( argv[++i] );
+		} else if( strcmp( argv[i], "--dump" ) == 0 ) {
+			iDump = atoi( argv[++i] );
+		} else {
+			printUsage( );
+			return -1;
+		}
+	}
+
+	if( iDump >= 0 ) {
+		IdlOutput xSchema;
+		xOpts.iDecls = (unsigned int)iDump;
+		IdlSynth::write( xSchema, xOpts );
+		xSchema.write( stdout );
+		return 0;
+	}
+
+	if( viSizes.empty() ) {
+		viSizes.push_back( 100 );
+		viSizes.push_back( 1000 );
+		viSizes.push_back( 10000 );
+		viSizes.push_back( 100000 );
+	}
+
+	if( bVerify ) {
+		return verifyLexer( xOpts, viSizes ) ? 0 : 1;
+	}
+
+	int iFailed = 0;
+	for( auto i = viSizes.begin(); i != viSizes.end(); ++i ) {
+		xOpts.iDecls = *i;
+		if( !benchSize( xOpts, dMinMs, iGenThreads ) ) {
+			iFailed++;
+		}
+	}
+	return iFailed ? 1 : 0;
+}
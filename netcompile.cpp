@@ -5,22 +5,36 @@
 #include <vector>
 #include <stdarg.h>
 #include <map>
+#include "IdlInput.h"
+#include "IdlKeywords.h"
+#include "IdlOutput.h"
 
-std::string _ftok( FILE* fh )
+struct SInputCursor
+{
+	const char *pcCur;
+	const char *pcEnd;
+	std::string sPeekTok;
+
+	SInputCursor( const IdlInput& xInput ) : pcCur(xInput.begin()), pcEnd(xInput.end()) { }
+
+	inline bool eof( ) const { return pcCur >= pcEnd; }
+};
+
+std::string _ftok( SInputCursor& xCur )
 {
 	bool bStartRead = false;
 
 	std::string sBuffer;
 	while( true ) {
-		int cChar = fgetc( fh );
-
-		if( cChar == EOF ) {
+		if( xCur.eof() ) {
 			return sBuffer;
 		}
 
+		int cChar = *xCur.pcCur++;
+
 		if( cChar == '{' || cChar == '}' || cChar == ';' ) {
 			if( bStartRead ) {
-				fseek( fh, -1, SEEK_CUR );
+				xCur.pcCur--;
 				return sBuffer;
 			} else {
 				sBuffer.push_back( cChar );
@@ -46,19 +60,45 @@ std::string _ftok( FILE* fh )
 	}
 }
 
-std::string g_PeekTok = "";
-std::string ftok( FILE* fh, bool no_term = false )
+// Section keywords; adding one only means adding a KEYWORD line here.
+#define SEC_KEYWORDS( KEYWORD ) \
+	KEYWORD( MESSAGE, "message" ) \
+	KEYWORD( ALIGN, "@align" ) \
+	KEYWORD( ENUM, "enum" ) \
+	KEYWORD( LIST, "list" ) \
+	KEYWORD( UNION, "union" ) \
+	KEYWORD( GROUP, "group" )
+
+#define SEC_KEYWORD_ENUM(x,s) eKey_##x,
+enum eKey
+{
+	eKey_NONE = -1,
+	SEC_KEYWORDS( SEC_KEYWORD_ENUM )
+};
+#undef SEC_KEYWORD_ENUM
+
+#define SEC_KEYWORD_ENTRY(x,s) { s, sizeof(s) - 1, eKey_##x },
+static constexpr SKeyword g_Keywords[] = {
+	SEC_KEYWORDS( SEC_KEYWORD_ENTRY )
+};
+#undef SEC_KEYWORD_ENTRY
+
+static constexpr auto g_KeywordTable = makeKeywordTable( g_Keywords );
+
+// Reads one token, or with no_term returns "" and keeps a terminator
+//  back for the next call.
+std::string ftok( SInputCursor& xCur, bool no_term = false )
 {
 	std::string sToken = "";
-	if( g_PeekTok != "" ) {
-		sToken = g_PeekTok;
-		g_PeekTok = "";
+	if( xCur.sPeekTok != "" ) {
+		sToken = xCur.sPeekTok;
+		xCur.sPeekTok = "";
 	} else {
-		sToken = _ftok(fh);
+		sToken = _ftok(xCur);
 	}
 
 	if( no_term && ( sToken == ";" || sToken == "}" || sToken == "{" ) ) {
-		g_PeekTok = sToken;
+		xCur.sPeekTok = sToken;
 		return "";
 	}
 		
@@ -78,33 +118,27 @@ struct STypeName
 	inline bool is_enum() { return iState == -4; }
 };
 
-int g_XIndents = 0;
-void XIndent( int iNum ) {
-	g_XIndents += iNum;
-}
-void XWrite( const char *format, ... ) {
-	for( int i = 0; i < g_XIndents; ++i ) printf( "  " );
+class SecBase;
 
-	va_list args;
-	va_start( args, format );
-	vprintf( format, args );
-	va_end( args );
-}
-
-int g_ZIndents = 0;
-void ZIndent( int iNum ) {
-	g_ZIndents += iNum;
-}
-void ZWrite( const char *format, ... ) {
-	for( int i = 0; i < g_ZIndents; ++i ) printf( "  " );
-
-	va_list args;
-	va_start( args, format );
-	vprintf( format, args );
-	va_end( args );
-}
-
-std::map<std::string,std::string> g_EnumMap;
+// Everything one compilation reads and writes. Sections reach it through
+//  their root, so separate compilations share nothing and may run on
+//  different threads at once.
+struct SCompileCtx
+{
+	SecBase* pNextPush;
+	std::vector<SecBase*> vStack;
+	std::map<std::string,std::string> xEnumMap;
+	IdlOutput xXOut;
+	IdlOutput xZOut;
+	int iReserved;
+	int iUnionCnt;
+
+	SCompileCtx( ) : pNextPush(nullptr), xXOut("  "), xZOut("  "), iReserved(0), iUnionCnt(0) { }
+	~SCompileCtx( );
+
+	// Back to a fresh context; the output buffers keep their storage
+	void reset( );
+};
 
 std::string GetXTypeName( std::string sType )
 {
@@ -168,7 +202,8 @@ enum eStage
 	eStage_Members,
 	eStage_Ser,
 	eStage_Unser,
-	eStage_GetSet
+	eStage_GetSet,
+	eStage_Size
 };
 
 enum eFlag {
@@ -183,13 +218,39 @@ class SecBase
 protected:
 	std::vector<SecBase*> m_Children;
 	SecBase* m_Parent;
+	SCompileCtx* m_pCtx;
+
+	void XIndent( int iNum ) {
+		m_pCtx->xXOut.indent( iNum );
+	}
+	void XWrite( const char *format, ... ) {
+		va_list args;
+		va_start( args, format );
+		m_pCtx->xXOut.vline( format, args );
+		va_end( args );
+	}
+
+	void ZIndent( int iNum ) {
+		m_pCtx->xZOut.indent( iNum );
+	}
+	void ZWrite( const char *format, ... ) {
+		va_list args;
+		va_start( args, format );
+		m_pCtx->xZOut.vline( format, args );
+		va_end( args );
+	}
 
 public:
-	SecBase( ) : m_Parent( nullptr ) { };
-	virtual ~SecBase( ) { };
+	SecBase( ) : m_Parent( nullptr ), m_pCtx( nullptr ) { };
+	virtual ~SecBase( ) {
+		for( auto i = m_Children.begin(); i != m_Children.end(); ++i ) {
+			delete *i;
+		}
+	};
 
 	void SetParent( SecBase* pParent ) {
 		m_Parent = pParent;
+		m_pCtx = pParent->m_pCtx;
 	}
 
 	size_t child_count( ) {
@@ -207,6 +268,22 @@ public:
 	virtual std::string friend_name( ) {
 		return "";
 	}
+
+	// Prefix naming a nested list class from the message's scope
+	virtual std::string list_scope( ) {
+		return m_Parent->list_scope( );
+	}
+
+	// Wire size of a field stored as the same bytes as its member, or 0.
+	//  iElem gets the size of one element.
+	virtual unsigned int fixed_size( unsigned int& iElem ) {
+		iElem = 0;
+		return 0;
+	}
+
+	virtual std::string member_name( ) {
+		return "";
+	}
 	
 	virtual void x_output( int iStage = 0 )
 	{
@@ -222,6 +299,77 @@ public:
 		}
 	}
 
+	// True when every child is a fixed-size param, so the class they are
+	//  members of is standard-layout
+	bool all_fixed( ) {
+		unsigned int iElem;
+		for( auto i = m_Children.begin(); i != m_Children.end(); ++i ) {
+			if( !(*i)->fixed_size( iElem ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// End of the run of fixed-size children from i that a compiler lays
+	//  out with no padding: no element wider than the first one's, each
+	//  at a wire offset that is a multiple of its element size. iOffset
+	//  gets the run's wire size and iLast the offset of its last child.
+	size_t run_end( size_t i, unsigned int& iOffset, unsigned int& iLast ) {
+		unsigned int iAlign;
+		unsigned int iElem;
+		iOffset = 0;
+		iLast = 0;
+		m_Children[i]->fixed_size( iAlign );
+
+		size_t iEnd = i;
+		for( ; iEnd < m_Children.size(); ++iEnd ) {
+			unsigned int iSize = m_Children[iEnd]->fixed_size( iElem );
+			if( iElem > iAlign || iOffset % iElem != 0 ) {
+				break;
+			}
+			iLast = iOffset;
+			iOffset += iSize;
+		}
+		return iEnd;
+	}
+
+	// Ser or Unser for the children of class sClass. When all_fixed(),
+	//  each run_end() run goes out as one memcpy, with a static_assert
+	//  that the members really sit as on the wire.
+	void z_output_fields( int iStage, const std::string& sClass )
+	{
+		if( !all_fixed() ) {
+			SecBase::z_output( iStage );
+			return;
+		}
+
+		for( size_t i = 0; i < m_Children.size(); ) {
+			unsigned int iOffset;
+			unsigned int iLast;
+			size_t iEnd = run_end( i, iOffset, iLast );
+
+			if( iEnd - i < 2 ) {
+				m_Children[i]->z_output( iStage );
+				++i;
+				continue;
+			}
+
+			SecBase* pFirst = m_Children[i];
+			SecBase* pLast = m_Children[iEnd - 1];
+			if( iStage == eStage_Ser ) {
+				ZWrite( "static_assert( offsetof(%s, _%s) - offsetof(%s, _%s) == %u, \"%s: members do not match the wire layout\" );\n",
+					sClass.c_str(), pLast->member_name().c_str(), sClass.c_str(), pFirst->member_name().c_str(), iLast, sClass.c_str() );
+				ZWrite( "memcpy( &data[len_out], &%s_%s, %u );\n", pFirst->param_path(iStage).c_str(), pFirst->member_name().c_str(), iOffset );
+				ZWrite( "len_out += %u;\n", iOffset );
+			} else {
+				ZWrite( "memcpy( &%s_%s, &data[cur_pos], %u );\n", pFirst->param_path(iStage).c_str(), pFirst->member_name().c_str(), iOffset );
+				ZWrite( "cur_pos += %u;\n", iOffset );
+			}
+			i = iEnd;
+		}
+	}
+
 	virtual eZType GetZType( ) { return eZType_Normal; }
 
 	virtual void AddChild( SecBase* pObj ) {
@@ -232,6 +380,10 @@ public:
 class SecRoot : public SecBase
 {
 public:
+	SecRoot( SCompileCtx* pCtx ) {
+		m_pCtx = pCtx;
+	}
+
 	virtual unsigned int flags( ) {
 		return eFlag_None;
 	}
@@ -239,6 +391,10 @@ public:
 	std::string param_path( int iStage = 0 ) {
 		return "";
 	}
+
+	std::string list_scope( ) {
+		return "";
+	}
 };
 
 class SecParam : public SecBase
@@ -252,10 +408,45 @@ public:
 	SecParam( STypeName xType, std::string sName, std::string sXName )
 		: m_xType(xType), m_sName(sName), m_sXName(sXName) { }
 
+	unsigned int fixed_size( unsigned int& iElem ) {
+		iElem = 0;
+		if( m_sName == "" || m_xType.is_bitfield() ) {
+			return 0;
+		}
+
+		const std::string& sType = m_xType.sName;
+		if( sType == "uint8" || sType == "int8" || sType == "char" || sType == "bool" ) {
+			iElem = 1;
+		} else if( sType == "uint16" || sType == "int16" ) {
+			iElem = 2;
+		} else if( sType == "uint32" || sType == "int32" || sType == "float" ) {
+			iElem = 4;
+		} else if( sType == "uint64" || sType == "int64" || sType == "double" ) {
+			iElem = 8;
+		} else {
+			return 0;
+		}
+
+		if( !m_xType.is_array() ) {
+			return iElem;
+		}
+		// A count given by a constant has no size known here
+		const std::string& sCount = m_xType.sArrayCount;
+		if( sCount.empty() || sCount.find_first_not_of( "0123456789" ) != std::string::npos ) {
+			iElem = 0;
+			return 0;
+		}
+		return iElem * (unsigned int)atoi( sCount.c_str() );
+	}
+
+	std::string member_name( ) {
+		return m_sName;
+	}
+
 	void x_output( int iStage = 0 ) {
 		std::string sType = m_xType.sName;
 		if( m_xType.is_enum() ) {
-			sType = g_EnumMap[ sType ];
+			sType = m_pCtx->xEnumMap[ sType ];
 		}
 
 		std::string sXType = GetXTypeName(sType);
@@ -295,8 +486,7 @@ public:
 					ZWrite( "%s _%s;\n", sZType.c_str(), m_sName.c_str() );
 				}
 			} else {
-				static int iReserved = 0;
-				iReserved++;
+				int iReserved = ++m_pCtx->iReserved;
 
 				if( m_xType.is_array() ) {
 					ZWrite( "%s _reserved_%d[%s];\n", sZType.c_str(), iReserved, m_xType.sArrayCount.c_str() );
@@ -373,6 +563,14 @@ public:
 			} else {
 				ZWrite( "cur_pos += sizeof(%s);\n", sZType.c_str() );
 			}
+		} else if( iStage == eStage_Size ) {
+			if( m_sName != "" && m_xType.sName == "string" ) {
+				ZWrite( "len_out += %s_%s.size()+1;\n", param_path(iStage).c_str(), m_sName.c_str() );
+			} else if( m_sName != "" && m_xType.is_array() ) {
+				ZWrite( "len_out += sizeof(%s) * %s;\n", sZType.c_str(), m_xType.sArrayCount.c_str() );
+			} else {
+				ZWrite( "len_out += sizeof(%s);\n", sZType.c_str() );
+			}
 		}
 	}
 };
@@ -416,10 +614,25 @@ public:
 		{
 			SecBase::z_output( eStage_GetSet );
 
+			ZWrite( "inline int serialized_size( ) {\n" );
+			ZIndent( +1 );
+			ZWrite( "int len_out = 0;\n" );
+			SecBase::z_output( eStage_Size );
+			ZWrite( "return len_out;\n" );
+			ZIndent( -1 );
+			ZWrite( "}\n" );
+
+			// One check up front, so the stores below need none
 			ZWrite( "inline bool serialize( char *data, int max_len, int& len_out ) {\n" );
 			ZIndent( +1 );
+			ZWrite( "len_out = serialized_size( );\n" );
+			ZWrite( "if( len_out > max_len ) {\n" );
+			ZIndent( +1 );
+			ZWrite( "return false;\n" );
+			ZIndent( -1 );
+			ZWrite( "}\n" );
 			ZWrite( "len_out = 0;\n" );
-			SecBase::z_output( eStage_Ser );
+			z_output_fields( eStage_Ser, friend_name() );
 			ZWrite( "return true;\n" );
 			ZIndent( -1 );
 			ZWrite( "}\n" );
@@ -427,7 +640,7 @@ public:
 			ZWrite( "inline bool unserialize( char *data, int len ) {\n" );
 			ZIndent( +1 );
 			ZWrite( "int cur_pos = 0;\n" );
-			SecBase::z_output( eStage_Unser );
+			z_output_fields( eStage_Unser, friend_name() );
 			ZWrite( "return true;\n" );
 			ZIndent( -1 );
 			ZWrite( "}\n" );
@@ -471,6 +684,25 @@ public:
 	SecList( std::string sName, std::string sType, std::string sXCntName, std::string sXVarName )
 		: m_sName(sName), m_sType(sType), m_sXCntName(sXCntName), m_sXVarName(sXVarName) { }
 
+	std::string list_scope( ) {
+		return m_Parent->list_scope( ) + m_sName + "::";
+	}
+
+	// Wire size of an element when the vector's storage can be copied as
+	//  it is: the children make up one run, and its size is a multiple of
+	//  the first child's element size, so there is no padding at the end
+	//  either. 0 otherwise.
+	unsigned int block_size( ) {
+		unsigned int iSize;
+		unsigned int iLast;
+		unsigned int iElem;
+		if( m_Children.empty() || !all_fixed() || run_end( 0, iSize, iLast ) != m_Children.size() ) {
+			return 0;
+		}
+		m_Children[0]->fixed_size( iElem );
+		return iSize % iElem == 0 ? iSize : 0;
+	}
+
 	std::string param_path( int iStage = 0 ) {
 		if( iStage != eStage_GetSet ) {
 			std::string sVarName = m_sName;
@@ -583,17 +815,81 @@ public:
 			ZWrite( "*((%s*)&data[len_out]) = (%s)%s_%ss.size( );\n", GetZTypeName(m_sType).c_str(), GetZTypeName(m_sType).c_str(), SecBase::param_path().c_str(), sVarName.c_str() );
 			ZWrite( "len_out += sizeof(%s);\n", GetZTypeName(m_sType).c_str() );
 
+			unsigned int iBlock = block_size( );
+			if( iBlock ) {
+				std::string sClass = m_Parent->list_scope() + m_sName;
+				ZWrite( "static_assert( sizeof(%s) == %u, \"%s: elements do not match the wire layout\" );\n", sClass.c_str(), iBlock, sClass.c_str() );
+				// An empty vector may have no storage, and memcpy takes no null
+				ZWrite( "if( !%s_%ss.empty( ) ) {\n", SecBase::param_path().c_str(), sVarName.c_str() );
+				ZIndent( +1 );
+				ZWrite( "memcpy( &data[len_out], %s_%ss.data( ), %s_%ss.size( ) * %u );\n",
+					SecBase::param_path().c_str(), sVarName.c_str(), SecBase::param_path().c_str(), sVarName.c_str(), iBlock );
+				ZWrite( "len_out += (int)%s_%ss.size( ) * %u;\n", SecBase::param_path().c_str(), sVarName.c_str(), iBlock );
+				ZIndent( -1 );
+				ZWrite( "}\n" );
+				return;
+			}
+
 			ZWrite( "for( auto %s_itr = %s_%ss.begin(); %s_itr != %s_%ss.end(); ++%s_itr ) {\n", 
 				sVarName.c_str(), SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str(), 
 				SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str() );
 			ZIndent( +1 );
 
-			SecBase::z_output( iStage );
+			z_output_fields( iStage, m_Parent->list_scope() + m_sName );
 
 			ZIndent( -1 );
 			ZWrite( "}\n" );
 		} else if( iStage == eStage_Unser ) {
+			// The count and then the whole block are checked against len
+			//  before the resize, so a bad count can neither read past the
+			//  buffer nor allocate more than the buffer could hold
+			unsigned int iBlock = block_size( );
+			if( iBlock ) {
+				std::string sCntType = GetZTypeName( m_sType );
+				ZWrite( "if( cur_pos > len || (size_t)( len - cur_pos ) < sizeof(%s) ) {\n", sCntType.c_str() );
+				ZIndent( +1 );
+				ZWrite( "return false;\n" );
+				ZIndent( -1 );
+				ZWrite( "}\n" );
+				ZWrite( "size_t %s_cnt = (size_t)*((%s*)&data[cur_pos]);\n", sVarName.c_str(), sCntType.c_str() );
+				ZWrite( "cur_pos += sizeof(%s);\n", sCntType.c_str() );
+				ZWrite( "if( %s_cnt > (size_t)( len - cur_pos ) / %u ) {\n", sVarName.c_str(), iBlock );
+				ZIndent( +1 );
+				ZWrite( "return false;\n" );
+				ZIndent( -1 );
+				ZWrite( "}\n" );
+				ZWrite( "%s_%ss.resize( %s_cnt );\n", SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str() );
+				ZWrite( "if( %s_cnt ) {\n", sVarName.c_str() );
+				ZIndent( +1 );
+				ZWrite( "memcpy( %s_%ss.data( ), &data[cur_pos], %s_cnt * %u );\n",
+					SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str(), iBlock );
+				ZWrite( "cur_pos += (int)( %s_cnt * %u );\n", sVarName.c_str(), iBlock );
+				ZIndent( -1 );
+				ZWrite( "}\n" );
+				return;
+			}
+
 			ZWrite( "%s_%ss.resize( (size_t)*((%s*)&data[cur_pos]) );\n", SecBase::param_path().c_str(), sVarName.c_str(), GetZTypeName(m_sType).c_str() );
+			ZWrite( "cur_pos += sizeof(%s);\n", GetZTypeName(m_sType).c_str() );
+
+			ZWrite( "for( auto %s_itr = %s_%ss.begin(); %s_itr != %s_%ss.end(); ++%s_itr ) {\n", 
+				sVarName.c_str(), SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str(), 
+				SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str() );
+			ZIndent( +1 );
+
+			z_output_fields( iStage, m_Parent->list_scope() + m_sName );
+
+			ZIndent( -1 );
+			ZWrite( "}\n" );
+		} else if( iStage == eStage_Size ) {
+			ZWrite( "len_out += sizeof(%s);\n", GetZTypeName(m_sType).c_str() );
+
+			unsigned int iBlock = block_size( );
+			if( iBlock ) {
+				ZWrite( "len_out += (int)%s_%ss.size( ) * %u;\n", SecBase::param_path().c_str(), sVarName.c_str(), iBlock );
+				return;
+			}
+
 			ZWrite( "for( auto %s_itr = %s_%ss.begin(); %s_itr != %s_%ss.end(); ++%s_itr ) {\n", 
 				sVarName.c_str(), SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str(), 
 				SecBase::param_path().c_str(), sVarName.c_str(), sVarName.c_str() );
@@ -613,10 +909,9 @@ protected:
 	std::string m_sName;
 
 public:
-	SecUnion( ) {
-		static int iUnionInfo = 0;
+	SecUnion( int iUnionInfo ) {
 		char tmp[32];
-		sprintf( tmp, "__union_%d", ++iUnionInfo );
+		sprintf( tmp, "__union_%d", iUnionInfo );
 		m_sName = tmp;
 	}
 
@@ -659,6 +954,10 @@ public:
 			ZWrite( "memcpy( &%s%s, &data[cur_pos], sizeof(%s%s) );\n", SecBase::param_path().c_str(), m_sName.c_str(), SecBase::param_path().c_str(), m_sName.c_str() );
 			ZWrite( "cur_pos += sizeof(%s%s);\n", SecBase::param_path().c_str(), m_sName.c_str() );
 
+		} else if( iStage == eStage_Size ) {
+
+			ZWrite( "len_out += sizeof(%s%s);\n", SecBase::param_path().c_str(), m_sName.c_str() );
+
 		}
 	}
 };
@@ -700,6 +999,8 @@ public:
 			SecBase::z_output( iStage );
 		} else if( iStage == eStage_Unser ) {
 			SecBase::z_output( iStage );
+		} else if( iStage == eStage_Size ) {
+			SecBase::z_output( iStage );
 		}
 	}
 };
@@ -763,47 +1064,61 @@ public:
 	}
 };
 
-SecBase* g_NextPush = nullptr;
-std::vector<SecBase*> g_Stack;
+SCompileCtx::~SCompileCtx( )
+{
+	delete pNextPush;
+}
+
+void SCompileCtx::reset( )
+{
+	delete pNextPush;
+	pNextPush = nullptr;
+	vStack.clear( );
+	xEnumMap.clear( );
+	xXOut.clear( );
+	xZOut.clear( );
+	iReserved = 0;
+	iUnionCnt = 0;
+}
 
-void StackPush( )
+void StackPush( SCompileCtx& xCtx )
 {
-	if( g_NextPush ) {
-		g_NextPush->SetParent( g_Stack.back() );
-		g_Stack.back()->AddChild( g_NextPush );
-		g_Stack.push_back( g_NextPush );
-		g_NextPush = nullptr;
+	if( xCtx.pNextPush ) {
+		xCtx.pNextPush->SetParent( xCtx.vStack.back() );
+		xCtx.vStack.back()->AddChild( xCtx.pNextPush );
+		xCtx.vStack.push_back( xCtx.pNextPush );
+		xCtx.pNextPush = nullptr;
 	} else {
 		throw std::exception( "Nothing to Push!" );
 	}
 }
 
-SecBase* GetStack( ) {
-	return g_Stack.back();
+SecBase* GetStack( SCompileCtx& xCtx ) {
+	return xCtx.vStack.back();
 }
 
-void StackPop( )
+void StackPop( SCompileCtx& xCtx )
 {
-	g_Stack.pop_back( );
+	xCtx.vStack.pop_back( );
 }
 
-void AddStack( SecBase* pNextPush )
+void AddStack( SCompileCtx& xCtx, SecBase* pNextPush )
 {
-	if( g_NextPush ) {
-		delete g_NextPush;
+	if( xCtx.pNextPush ) {
+		delete xCtx.pNextPush;
 	}
-	g_NextPush = pNextPush;
+	xCtx.pNextPush = pNextPush;
 }
 
-void AddSec( SecBase* pObj )
+void AddSec( SCompileCtx& xCtx, SecBase* pObj )
 {
-	pObj->SetParent( g_Stack.back() );
-	g_Stack.back()->AddChild( pObj );
+	pObj->SetParent( xCtx.vStack.back() );
+	xCtx.vStack.back()->AddChild( pObj );
 }
 
-eZType GetStackZType( )
+eZType GetStackZType( SCompileCtx& xCtx )
 {
-	return g_Stack.back()->GetZType();
+	return xCtx.vStack.back()->GetZType();
 }
 
 STypeName ParseTypeName( std::string sType ) {
@@ -852,122 +1167,200 @@ STypeName ParseTypeName( std::string sType ) {
 	return xOut;
 }
 
-int main( int argc, char* argv[] )
+// Compiles one schema held in memory. The generated code is left in
+//  xCtx.xXOut and xCtx.xZOut, and a failure is described in sError.
+//  xCtx is reset first, so one context may be reused for several schemas.
+bool CompileBuffer( SCompileCtx& xCtx, const IdlInput& xInput, size_t& iMsgCnt, std::string& sError )
 {
-	FILE* fh = fopen( "c:\\Users\\Brett\\Desktop\\testIdl.txt", "rb" );
-	if( !fh ) {
-		printf( "Error Opening File!\n" );
-		return 1;
-	}
+	xCtx.reset( );
+	SInputCursor xCur( xInput );
+	SecRoot xRoot( &xCtx );
+	bool bSuccess = false;
 
 	try {
 	
-		SecBase* pRoot = new SecRoot( );
-		g_Stack.push_back(pRoot);
+		SecBase* pRoot = &xRoot;
+		xCtx.vStack.push_back(pRoot);
 
-		while( !feof(fh) ) {
+		while( !xCur.eof() ) {
 
-			std::string sToken = ftok(fh);
+			std::string sToken = ftok(xCur);
 
 			if( sToken == ";" ) {
 				continue;
 			} else if( sToken == "{" ) {
-				StackPush( );
+				StackPush( xCtx );
 				continue;
 			} else if( sToken == "}" ) {
-				StackPop( );
+				StackPop( xCtx );
 				continue;
 			} else if( sToken == "" ) {
 				continue;
 			}
 
-			if( GetStackZType() == eZType_Normal )
+			if( GetStackZType( xCtx ) == eZType_Normal )
 			{
-				if( sToken == "message" ) {
-					std::string sName = ftok(fh);
-					AddStack( new SecMessage(sName) );
+				eKey iKey = (eKey)g_KeywordTable.lookup( sToken.data(), sToken.size(), eKey_NONE );
+
+				if( iKey == eKey_MESSAGE ) {
+					std::string sName = ftok(xCur);
+					AddStack( xCtx, new SecMessage(sName) );
 					continue;
 				}
 
-				if( sToken == "@align" ) {
-					std::string sAlignBytes = ftok(fh);
-					AddStack( new SecAlign(sAlignBytes) );
+				if( iKey == eKey_ALIGN ) {
+					std::string sAlignBytes = ftok(xCur);
+					AddStack( xCtx, new SecAlign(sAlignBytes) );
 					continue;
 				}
 
-				if( sToken == "enum" ) {
-					std::string sName = ftok(fh);
-					std::string sType = ftok(fh);
+				if( iKey == eKey_ENUM ) {
+					std::string sName = ftok(xCur);
+					std::string sType = ftok(xCur);
 					STypeName xType = ParseTypeName(sType);
 
 					if( xType.is_array() || xType.is_bitfield() ) {
 						throw std::exception( "Enum Type cannot be Array or Bitfield!" );
 					}
 
-					g_EnumMap.insert(std::pair<std::string,std::string>(sName,sType));
-					AddStack(new SecEnum(sName,xType));
+					xCtx.xEnumMap.insert(std::pair<std::string,std::string>(sName,sType));
+					AddStack( xCtx, new SecEnum(sName,xType) );
 					continue;
 				};
 
-				if( sToken == "list" ) {
-					std::string sType = ftok(fh);
-					std::string sName = ftok(fh);
-					std::string sXCntName = ftok(fh,true);
-					std::string sXVarName = ftok(fh,true);
-					AddStack( new SecList(sName,sType,sXCntName,sXVarName) );
+				if( iKey == eKey_LIST ) {
+					std::string sType = ftok(xCur);
+					std::string sName = ftok(xCur);
+					std::string sXCntName = ftok(xCur,true);
+					std::string sXVarName = ftok(xCur,true);
+					AddStack( xCtx, new SecList(sName,sType,sXCntName,sXVarName) );
 					continue;
 				};
 
-				if( sToken == "union" ) {
-					AddStack( new SecUnion() );
+				if( iKey == eKey_UNION ) {
+					AddStack( xCtx, new SecUnion( ++xCtx.iUnionCnt ) );
 					continue;
 				}
 
-				if( sToken == "group" ) {
-					std::string sXName = ftok(fh,true);
-					AddStack( new SecGroup(sXName) );
+				if( iKey == eKey_GROUP ) {
+					std::string sXName = ftok(xCur,true);
+					AddStack( xCtx, new SecGroup(sXName) );
 					continue;
 				}
 
 				// Normal Parameters
 				std::string sType = sToken;
-				std::string sName = ftok(fh);
-				std::string sXName = ftok(fh,true);
+				std::string sName = ftok(xCur);
+				std::string sXName = ftok(xCur,true);
 				STypeName xType = ParseTypeName(sType);
 
 				if( sXName == "%" ) sXName = "";
 				if( sName == "%" ) sName = "";
 
-				AddSec(new SecParam( xType, sName, sXName ));
+				AddSec( xCtx, new SecParam( xType, sName, sXName ) );
 			}
-			else if( GetStackZType() == eZType_Enum )
+			else if( GetStackZType( xCtx ) == eZType_Enum )
 			{
 				std::string sEId = sToken;
-				std::string sEName = ftok(fh);
-				std::string sEXName = ftok(fh,true);
+				std::string sEName = ftok(xCur);
+				std::string sEXName = ftok(xCur,true);
 
-				AddSec(new SecEnumEntry( sEName, sEXName, sEId ));
+				AddSec( xCtx, new SecEnumEntry( sEName, sEXName, sEId ) );
 			}
 		}
 
-		if( GetStack() != pRoot ) {
+		if( GetStack( xCtx ) != pRoot ) {
 			throw std::exception( "Parser Error - Invalid Root" );
 		}
-		g_Stack.pop_back( );
+		xCtx.vStack.pop_back( );
 
-		size_t iMsgCnt = pRoot->child_count();
+		iMsgCnt = pRoot->child_count();
 
 		//pRoot->x_output( );
 		pRoot->z_output( );
+		bSuccess = true;
+	} catch( std::exception& e ) {
+		sError = e.what( );
+	}
 
-		printf( "Compiled %d Messages\n", iMsgCnt );
+	xCtx.vStack.clear( );
+	return bSuccess;
+}
 
-		delete pRoot;
-	} catch( std::exception& e ) {
-		printf( "EXCEPTION: %s\n", e.what() );
+bool CompileFile( const char *pcFilename, const char *pcOutput )
+{
+	IdlInput xInput;
+	if( !xInput.open( pcFilename ) ) {
+		printf( "%s: Error Opening File!\n", pcFilename );
+		return false;
+	}
+
+	SCompileCtx xCtx;
+	size_t iMsgCnt = 0;
+	std::string sError;
+	if( !CompileBuffer( xCtx, xInput, iMsgCnt, sError ) ) {
+		if( !pcOutput ) {
+			xCtx.xXOut.write( stdout );
+			xCtx.xZOut.write( stdout );
+		}
+		printf( "%s: EXCEPTION: %s\n", pcFilename, sError.c_str() );
+		return false;
+	}
+
+	bool bSuccess;
+	if( pcOutput ) {
+		bSuccess = xCtx.xZOut.write_file( pcOutput );
+		if( !bSuccess ) {
+			printf( "%s: Error Writing File!\n", pcOutput );
+		}
+	} else {
+		xCtx.xXOut.write( stdout );
+		xCtx.xZOut.write( stdout );
+		bSuccess = true;
+	}
+
+	printf( "%s: Compiled %u Messages\n", pcFilename, (unsigned)iMsgCnt );
+	return bSuccess;
+}
+
+int main( int argc, char* argv[] )
+{
+	const char *pcOutDir = nullptr;
+	int iFiles = 0;
+	int iFailed = 0;
+
+	for( int i = 1; i < argc; ++i ) {
+		if( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) {
+			pcOutDir = argv[++i];
+			IdlOutput::make_dir( pcOutDir );
+			continue;
+		} else if( argv[i][0] == '-' && argv[i][1] != '\0' ) {
+			printf( "usage: netcompile [-o <dir>] <file.idl>...\n" );
+			return 1;
+		}
+
+		// Without -o the generated code goes to stdout as before
+		std::string sOutput;
+		if( pcOutDir ) {
+			std::string sName = argv[i];
+			size_t iSlash = sName.find_last_of( "/\\" );
+			if( iSlash != std::string::npos ) sName = sName.substr( iSlash + 1 );
+			size_t iDot = sName.find_last_of( '.' );
+			if( iDot != std::string::npos ) sName = sName.substr( 0, iDot );
+			sOutput = std::string(pcOutDir) + "/" + sName + ".h";
+		}
+
+		iFiles++;
+		if( !CompileFile( argv[i], pcOutDir ? sOutput.c_str() : nullptr ) ) {
+			iFailed++;
+		}
+	}
+
+	if( iFiles == 0 ) {
+		printf( "usage: netcompile [-o <dir>] <file.idl>...\n" );
+		return 1;
 	}
 
-	fclose( fh );
 	//system( "PAUSE" );
-	return 0;
+	return iFailed ? 1 : 0;
 }
\ No newline at end of file
@@ -1,44 +1,258 @@
 #include <iostream>
-#include "IdlLexer.h"
-#include "IdlParser.h"
-#include "IdlResolver.h"
-#include "CppGenerator.h"
+#include <string.h>
+#include <stdlib.h>
 
-int main( int argc, char* argv[] )
+// Counts heap use per phase for --profile; see IdlProfile.h
+#define IDL_PROFILE_ALLOCS
+#include "IdlDriver.h"
+#include "IdlWatcher.h"
+
+static void printUsage( )
 {
-	char *pcFilename = "C:\\Users\\Brett\\Desktop\\newIdl.txt";
+	printf( "usage: netcompilev2 [-j <threads>] [--gen-threads <threads>] [-o <dir>] [--cache <dir>] [--snapshots <dir>] [--stats] [--profile] [--profile-json <file>] [--split] [--split-include <hdr>] [--views] [--roots <name,...>] [--watch] <file.idl>...\n" );
+	printf( "       netcompilev2 --bench-snapshot <file.idl>\n" );
+	printf( "  -j <threads>      compile on this many threads (default: one per core)\n" );
+	printf( "  --gen-threads <threads>  generate each file's messages on this many threads (default 1, 0 for one per core)\n" );
+	printf( "  -o <dir>          write outputs for the files that follow into <dir>, created if missing\n" );
+	printf( "  --cache <dir>     reuse output for inputs compiled before, kept in <dir>\n" );
+	printf( "  --snapshots <dir> keep validated ASTs in <dir> and reload them instead of parsing\n" );
+	printf( "  --stats           report cache hits and output writes\n" );
+	printf( "  --profile         report time, allocations and peak heap for each compiler phase\n" );
+	printf( "  --profile-json <file>  write the same report to <file> as JSON\n" );
+	printf( "  --split           write per-namespace headers, with serializer bodies in .cpp files beside them\n" );
+	printf( "  --split-include <hdr>  the runtime header each split .cpp includes first (default NetEncoding.h)\n" );
+	printf( "  --views           also generate a read-only view_X, parsed in place, beside each message\n" );
+	printf( "  --roots <name,...> generate only these messages and namespaces; type_ids are unchanged\n" );
+	printf( "  --watch           keep running and recompile each file when it is saved\n" );
+}
 
-	FILE *fHandle = fopen( pcFilename, "rb" );
+// Times a full lex, parse and validate of one file against reloading the
+//  same validated AST from a snapshot image.
+static int benchSnapshot( const char *pcFilename )
+{
+	const int ITERATIONS = 50;
 
-	if( !fHandle ) {
-		printf( "Failed to open input file!" );
-		return -1;
+	IdlInput xInput;
+	if( !xInput.open( pcFilename ) ) {
+		printf( "%s: failed to open input file\n", pcFilename );
+		return 1;
 	}
 
+	IdlOutput xImageOut;
+	double dParseMs = 0;
 	try {
-		IdlLexer xLexer( fHandle );
-		// xLexer.dbgOutput( );
-
-		IdlParser xParser( &xLexer );
-		xParser.parse( );
-		//xParser.dbgOutput( );
+		for( int i = 0; i < ITERATIONS; ++i ) {
+			auto xStart = std::chrono::steady_clock::now( );
+			IdlSymbols xSymbols;
+			IdlLexer xLexer( &xInput, &xSymbols );
+			IdlTokenList xTokens;
+			IdlParser xParser( &xTokens, &xSymbols );
+			xLexer.tokenize( xTokens );
+			xParser.parse( );
+			IdlResolver xResolver( &xParser.get_ast() );
+			xResolver.validate( );
+			dParseMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
 
-		IdlResolver xResolver( xParser.get_root() );
-		xResolver.validate( );
+			if( i == 0 ) {
+				IdlSnapshot::write( xImageOut, xParser.get_ast(), 0 );
+			}
+		}
+	} catch( std::exception& e ) {
+		printf( "%s: cannot benchmark a file that does not compile: %s\n", pcFilename, e.what() );
+		return 1;
+	}
 
-		CppGenerator xGen( xParser.get_root() );
-		xGen.generate( );
+	std::string sImagePath = std::string(pcFilename) + ".idls";
+	if( !xImageOut.write_file( sImagePath.c_str() ) ) {
+		printf( "%s: failed to write snapshot\n", sImagePath.c_str() );
+		return 1;
+	}
 
-	} catch( LexException e ) {
-		printf( "%s(%d): lexer error: %s\n", pcFilename, e.line_num(), e.what() );
-	} catch( ParseTokException e ) {
-		printf( "%s(%d): parser error: %s -> '%s'\n", pcFilename, e.token().iLineNum, e.what(), e.token().sText.c_str() );
-	} catch( ResolveException e ) {
-		printf( "%s(%d): validate error: %s\n", pcFilename, e.node()->line_num(), e.what() );
-	} catch( GenException e ) {
-		printf( "%s(%d): validate error: %s\n", pcFilename, e.node()->line_num(), e.what() );
+	double dLoadMs = 0;
+	for( int i = 0; i < ITERATIONS; ++i ) {
+		auto xStart = std::chrono::steady_clock::now( );
+		IdlInput xImage;
+		IdlSymbols xSymbols;
+		IdlAst xAst( &xSymbols );
+		IdlLayouts xLayouts;
+		if( !xImage.open( sImagePath.c_str() ) || !IdlSnapshot::load( xImage, 0, xSymbols, xAst ) ) {
+			printf( "%s: snapshot failed to load\n", sImagePath.c_str() );
+			return 1;
+		}
+		xLayouts.build( &xAst );
+		dLoadMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
 	}
+	remove( sImagePath.c_str() );
 
-	system( "PAUSE" );
+	printf( "%s: %u bytes source, %u bytes snapshot\n", pcFilename, (unsigned)xInput.size(), (unsigned)xImageOut.size() );
+	printf( "  lex+parse+validate  %8.3f ms\n", dParseMs / ITERATIONS );
+	printf( "  snapshot load       %8.3f ms\n", dLoadMs / ITERATIONS );
 	return 0;
-}
\ No newline at end of file
+}
+
+// One object per input, in command-line order, as a JSON array
+static bool writeProfileJson( const IdlDriver& xDriver, const char *pcPath )
+{
+	IdlOutput xOut;
+	xOut.text( "[\n" );
+	for( auto i = xDriver.jobs().begin(); i != xDriver.jobs().end(); ++i ) {
+		xOut.text( "  %s%s\n", i->xProfile.json( i->sInput.c_str() ).c_str(), i + 1 != xDriver.jobs().end() ? "," : "" );
+	}
+	xOut.text( "]\n" );
+	return xOut.write_file( pcPath );
+}
+
+// Recompiles each file as it is saved, reporting the time from the save
+//  being noticed to its header being up to date. Files never depend on
+//  one another, so a save only ever rebuilds the file itself.
+static int watchFiles( IdlDriver& xDriver )
+{
+	IdlWatcher xWatcher;
+	for( size_t i = 0; i < xDriver.jobs().size(); ++i ) {
+		const std::string& sInput = xDriver.jobs()[i].sInput;
+		if( sInput == "-" || !xWatcher.add( sInput, i ) ) {
+			printf( "%s: cannot watch this input\n", sInput.c_str() );
+			return 1;
+		}
+	}
+	printf( "watching %u files\n", (unsigned)xDriver.jobs().size() );
+	fflush( stdout );
+
+	std::vector<size_t> viChanged;
+	while( xWatcher.wait( viChanged ) ) {
+		for( auto i = viChanged.begin(); i != viChanged.end(); ++i ) {
+			auto xStart = std::chrono::steady_clock::now( );
+			xDriver.recompile( *i );
+			double dMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - xStart ).count( );
+
+			const SCompileJob& xJob = xDriver.jobs()[*i];
+			fputs( xJob.sDiagnostics.c_str(), stdout );
+			if( xJob.bSuccess ) {
+				printf( "%s: %s in %.2f ms\n", xJob.sInput.c_str(), xJob.bWritten ? "regenerated" : "unchanged", dMs );
+			}
+		}
+		fflush( stdout );
+	}
+
+	printf( "file watch failed\n" );
+	return 1;
+}
+
+int main( int argc, char* argv[] )
+{
+	IdlDriver xDriver;
+	unsigned int iThreads = 0;
+	unsigned int iGenThreads = 1;
+	const char *pcOutDir = nullptr;
+	const char *pcCacheDir = nullptr;
+	const char *pcSnapshotDir = nullptr;
+	bool bStats = false;
+	bool bProfile = false;
+	const char *pcProfileJson = nullptr;
+	bool bWatch = false;
+	bool bSplit = false;
+	const char *pcSplitInclude = "NetEncoding.h";
+	bool bViews = false;
+	std::vector<std::string> vRoots;
+	std::string sOptions;
+
+	for( int i = 1; i < argc; ++i ) {
+		if( strcmp( argv[i], "-j" ) == 0 && i + 1 < argc ) {
+			iThreads = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "--gen-threads" ) == 0 && i + 1 < argc ) {
+			iGenThreads = (unsigned int)atoi( argv[++i] );
+		} else if( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) {
+			pcOutDir = argv[++i];
+			IdlOutput::make_dir( pcOutDir );
+		} else if( strcmp( argv[i], "--cache" ) == 0 && i + 1 < argc ) {
+			pcCacheDir = argv[++i];
+		} else if( strcmp( argv[i], "--snapshots" ) == 0 && i + 1 < argc ) {
+			pcSnapshotDir = argv[++i];
+		} else if( strcmp( argv[i], "--bench-snapshot" ) == 0 && i + 1 < argc ) {
+			return benchSnapshot( argv[i+1] );
+		} else if( strcmp( argv[i], "--profile" ) == 0 ) {
+			bProfile = true;
+		} else if( strcmp( argv[i], "--profile-json" ) == 0 && i + 1 < argc ) {
+			pcProfileJson = argv[++i];
+		} else if( strcmp( argv[i], "--stats" ) == 0 ) {
+			bStats = true;
+		} else if( strcmp( argv[i], "--split" ) == 0 ) {
+			bSplit = true;
+		} else if( strcmp( argv[i], "--split-include" ) == 0 && i + 1 < argc ) {
+			pcSplitInclude = argv[++i];
+		} else if( strcmp( argv[i], "--views" ) == 0 ) {
+			bViews = true;
+		} else if( strcmp( argv[i], "--roots" ) == 0 && i + 1 < argc ) {
+			const char *pcRoots = argv[++i];
+			for( const char *pcEnd = pcRoots; ; ++pcEnd ) {
+				if( *pcEnd == ',' || *pcEnd == '\0' ) {
+					if( pcEnd != pcRoots ) {
+						vRoots.push_back( std::string( pcRoots, pcEnd ) );
+					}
+					if( *pcEnd == '\0' ) {
+						break;
+					}
+					pcRoots = pcEnd + 1;
+				}
+			}
+		} else if( strcmp( argv[i], "--watch" ) == 0 ) {
+			bWatch = true;
+		} else if( argv[i][0] == '-' && argv[i][1] != '\0' ) {
+			printUsage( );
+			return -1;
+		} else {
+			xDriver.add( argv[i], IdlDriver::output_path( argv[i], pcOutDir ) );
+		}
+	}
+
+	if( xDriver.jobs().empty() ) {
+		printUsage( );
+		return -1;
+	}
+
+	// The roots and views are the only options that change generated output
+	for( auto i = vRoots.begin(); i != vRoots.end(); ++i ) {
+		sOptions += ( i == vRoots.begin() ? "roots=" : "," ) + *i;
+	}
+	if( bViews ) {
+		sOptions += sOptions.empty() ? "views" : ";views";
+	}
+	if( pcCacheDir ) {
+		xDriver.set_cache( pcCacheDir, sOptions );
+	}
+	if( pcSnapshotDir ) {
+		xDriver.set_snapshots( pcSnapshotDir );
+	}
+	xDriver.set_profile( bProfile || pcProfileJson );
+	xDriver.set_gen_threads( iGenThreads );
+	xDriver.set_split( bSplit, pcSplitInclude );
+	xDriver.set_views( bViews );
+	xDriver.set_roots( vRoots );
+
+	size_t iFailed = xDriver.run( iThreads );
+
+	// Reported in command-line order regardless of which thread finished first
+	for( auto i = xDriver.jobs().begin(); i != xDriver.jobs().end(); ++i ) {
+		fputs( i->sDiagnostics.c_str(), stdout );
+	}
+	if( bStats ) {
+		fputs( xDriver.summary().c_str(), stdout );
+	}
+	if( bProfile ) {
+		for( auto i = xDriver.jobs().begin(); i != xDriver.jobs().end(); ++i ) {
+			if( i->bCacheHit ) {
+				printf( "%s: cache hit, nothing compiled\n", i->sInput.c_str() );
+			} else {
+				fputs( i->xProfile.text( i->sInput.c_str() ).c_str(), stdout );
+			}
+		}
+	}
+	if( pcProfileJson && !writeProfileJson( xDriver, pcProfileJson ) ) {
+		printf( "%s: failed to write profile\n", pcProfileJson );
+	}
+	if( bWatch ) {
+		return watchFiles( xDriver );
+	}
+
+	return iFailed ? 1 : 0;
+}